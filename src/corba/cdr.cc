@@ -1,6 +1,9 @@
 #include "cdr.hh"
+#include "util/byteswap.hh"
 
 #include <bit>
+#include <cstdint>
+#include <cstring>
 #include <format>
 #include <iostream>
 
@@ -8,18 +11,55 @@ using namespace std;
 
 namespace CORBA {
 
+void CDREncoder::grow(size_t nbytes) {
+    auto size = _data->size();
+    auto capacity = _data->capacity();
+    if (capacity < nbytes) {
+        _data->reserve(max(nbytes, max(capacity * 2, minCapacity)));
+    }
+    // the bytes are not initialized by resize(), hence zero those which were
+    // skipped by alignment or skipGIOPHeader() and are not written by the caller
+    _data->resize(nbytes);
+    auto gap = min(physical(offset), nbytes);
+    if (gap > size) {
+        memset(_data->data() + size, 0, gap - size);
+    }
+}
+
+size_t CDREncoder::physicalBeforeSegments(size_t offset) const {
+    size_t skipped = 0;
+    for (auto &segment : segments) {
+        if (offset < segment.position + skipped) {
+            break;
+        }
+        if (offset < segment.position + skipped + segment.size) {
+            throw runtime_error("internal error: CDREncoder: attempt to write into a segment");
+        }
+        skipped += segment.size;
+    }
+    return offset - skipped;
+}
+
+void CDREncoder::appendSegment(const char *value, size_t nbytes) {
+    reserve();
+    segments.push_back({physical(offset), value, nbytes});
+    external += nbytes;
+    offset += nbytes;
+    segmentsEnd = offset;
+}
+
 void CDREncoder::writeEndian() { writeOctet(endian::native == endian::big ? 0 : 1); }
 
 void CDREncoder::writeBoolean(bool value) {
     reserve(offset + 1);
-    auto ptr = reinterpret_cast<uint8_t *>(_data->data() + offset);
+    auto ptr = reinterpret_cast<uint8_t *>(_data->data() + physical(offset));
     offset += 1;
     *ptr = value ? 1 : 0;
 }
 
 void CDREncoder::writeOctet(uint8_t value) {
     reserve(offset + 1);
-    auto ptr = reinterpret_cast<uint8_t *>(_data->data() + offset);
+    auto ptr = reinterpret_cast<uint8_t *>(_data->data() + physical(offset));
     offset += 1;
     *ptr = value;
 }
@@ -27,7 +67,7 @@ void CDREncoder::writeOctet(uint8_t value) {
 void CDREncoder::writeUshort(uint16_t value) {
     align2();
     reserve(offset + 2);
-    auto ptr = reinterpret_cast<uint16_t *>(_data->data() + offset);
+    auto ptr = reinterpret_cast<uint16_t *>(_data->data() + physical(offset));
     offset += 2;
     *ptr = value;
 }
@@ -35,7 +75,7 @@ void CDREncoder::writeUshort(uint16_t value) {
 void CDREncoder::writeUlong(uint32_t value) {
     align4();
     reserve(offset + 4);
-    auto ptr = reinterpret_cast<uint32_t *>(_data->data() + offset);
+    auto ptr = reinterpret_cast<uint32_t *>(_data->data() + physical(offset));
     offset += 4;
     *ptr = value;
 }
@@ -43,7 +83,7 @@ void CDREncoder::writeUlong(uint32_t value) {
 void CDREncoder::writeUlonglong(uint64_t value) {
     align8();
     reserve(offset + 8);
-    auto ptr = reinterpret_cast<uint64_t *>(_data->data() + offset);
+    auto ptr = reinterpret_cast<uint64_t *>(_data->data() + physical(offset));
     offset += 8;
     *ptr = value;
 }
@@ -51,7 +91,7 @@ void CDREncoder::writeUlonglong(uint64_t value) {
 void CDREncoder::writeShort(int16_t value) {
     align2();
     reserve(offset + 2);
-    auto ptr = reinterpret_cast<int16_t *>(_data->data() + offset);
+    auto ptr = reinterpret_cast<int16_t *>(_data->data() + physical(offset));
     offset += 2;
     *ptr = value;
 }
@@ -59,7 +99,7 @@ void CDREncoder::writeShort(int16_t value) {
 void CDREncoder::writeLong(int32_t value) {
     align4();
     reserve(offset + 4);
-    auto ptr = reinterpret_cast<int32_t *>(_data->data() + offset);
+    auto ptr = reinterpret_cast<int32_t *>(_data->data() + physical(offset));
     offset += 4;
     *ptr = value;
 }
@@ -67,7 +107,7 @@ void CDREncoder::writeLong(int32_t value) {
 void CDREncoder::writeLonglong(int64_t value) {
     align8();
     reserve(offset + 8);
-    auto ptr = reinterpret_cast<int64_t *>(_data->data() + offset);
+    auto ptr = reinterpret_cast<int64_t *>(_data->data() + physical(offset));
     offset += 8;
     *ptr = value;
 }
@@ -75,7 +115,7 @@ void CDREncoder::writeLonglong(int64_t value) {
 void CDREncoder::writeFloat(float value) {
     align4();
     reserve(offset + 4);
-    auto ptr = reinterpret_cast<float *>(_data->data() + offset);
+    auto ptr = reinterpret_cast<float *>(_data->data() + physical(offset));
     offset += 4;
     *ptr = value;
 }
@@ -83,7 +123,7 @@ void CDREncoder::writeFloat(float value) {
 void CDREncoder::writeDouble(double value) {
     align8();
     reserve(offset + 8);
-    auto ptr = reinterpret_cast<double *>(_data->data() + offset);
+    auto ptr = reinterpret_cast<double *>(_data->data() + physical(offset));
     offset += 8;
     *ptr = value;
 }
@@ -91,7 +131,7 @@ void CDREncoder::writeDouble(double value) {
 void CDREncoder::writeBlob(const char *value, size_t nbytes) {
     writeUlong(nbytes);
     reserve(offset + nbytes);
-    memcpy(_data->data() + offset, value, nbytes);
+    memcpy(_data->data() + physical(offset), value, nbytes);
     offset += nbytes;
 }
 
@@ -99,30 +139,73 @@ void CDREncoder::writeString(const char *value) { writeString(value, strlen(valu
 void CDREncoder::writeString(const char *value, size_t nbytes) {
     writeUlong(nbytes + 1);
     reserve(offset + nbytes + 1);
-    memcpy(_data->data() + offset, value, nbytes);
+    memcpy(_data->data() + physical(offset), value, nbytes);
     offset += nbytes;
-    _data->at(offset) = 0;
+    _data->at(physical(offset)) = 0;
     ++offset;
 }
 
-void CDREncoder::writeSequence(const std::span<float> & value) {
-    writeUlong(value.size());
-    // align4(); already aligned at 4
-    auto nbytes = 4 * value.size();
+template <typename T>
+void CDREncoder::writeSequenceOf(const T *values, size_t count) {
+    writeUlong(count);
+    // the length left us aligned at 4
+    if constexpr (sizeof(T) == 8) {
+        align8();
+    }
+    auto nbytes = sizeof(T) * count;
     reserve(offset + nbytes);
-    auto ptr = reinterpret_cast<float *>(_data->data() + offset);
-    memcpy(ptr, value.data(), nbytes);
+    memcpy(_data->data() + physical(offset), values, nbytes);
     offset += nbytes;
 }
 
-void CDREncoder::writeSequence(const std::span<double> & value) {
+void CDREncoder::writeSequence(const std::span<float> &value) { writeSequenceOf(value.data(), value.size()); }
+void CDREncoder::writeSequence(const std::span<double> &value) { writeSequenceOf(value.data(), value.size()); }
+void CDREncoder::writeSequence(std::span<const uint8_t> value) { writeSequenceOf(value.data(), value.size()); }
+void CDREncoder::writeSequence(std::span<const int16_t> value) { writeSequenceOf(value.data(), value.size()); }
+void CDREncoder::writeSequence(std::span<const uint16_t> value) { writeSequenceOf(value.data(), value.size()); }
+void CDREncoder::writeSequence(std::span<const int32_t> value) { writeSequenceOf(value.data(), value.size()); }
+void CDREncoder::writeSequence(std::span<const uint32_t> value) { writeSequenceOf(value.data(), value.size()); }
+void CDREncoder::writeSequence(std::span<const int64_t> value) { writeSequenceOf(value.data(), value.size()); }
+void CDREncoder::writeSequence(std::span<const uint64_t> value) { writeSequenceOf(value.data(), value.size()); }
+
+void CDREncoder::writeSequence(const std::vector<bool> &value) {
     writeUlong(value.size());
-    align8();
+    reserve(offset + value.size());
+    auto ptr = _data->data() + physical(offset);
+    for (bool item : value) {
+        *ptr++ = item ? 1 : 0;
+    }
+    offset += value.size();
+}
+
+void CDREncoder::writeBlobView(const char *value, size_t nbytes) {
+    if (nbytes < minSegmentSize) {
+        writeBlob(value, nbytes);
+        return;
+    }
+    writeUlong(nbytes);
+    appendSegment(value, nbytes);
+}
+
+void CDREncoder::writeSequenceView(const std::span<float> &value) {
+    auto nbytes = 4 * value.size();
+    if (nbytes < minSegmentSize) {
+        writeSequence(value);
+        return;
+    }
+    writeUlong(value.size());
+    appendSegment(reinterpret_cast<const char *>(value.data()), nbytes);
+}
+
+void CDREncoder::writeSequenceView(const std::span<double> &value) {
     auto nbytes = 8 * value.size();
-    reserve(offset + nbytes);
-    auto ptr = reinterpret_cast<double *>(_data->data() + offset);
-    memcpy(ptr, value.data(), nbytes);
-    offset += nbytes;
+    if (nbytes < minSegmentSize) {
+        writeSequence(value);
+        return;
+    }
+    writeUlong(value.size());
+    align8();
+    appendSegment(reinterpret_cast<const char *>(value.data()), nbytes);
 }
 
 void CDREncoder::reserveSize() {
@@ -228,7 +311,7 @@ float CDRDecoder::readFloat() {
     auto ptr = reinterpret_cast<const float *>(ptr4());
     float value = *ptr;
     if (std::endian::native != _endian) {
-        value = __builtin_bswap32(value);
+        value = detail::byteswapValue(value);
     }
     return value;
 }
@@ -236,7 +319,7 @@ float CDRDecoder::readFloat() {
 double CDRDecoder::readDouble() {
     auto value = *reinterpret_cast<const double *>(ptr8());
     if (std::endian::native != _endian) {
-        value = __builtin_bswap64(value);
+        value = detail::byteswapValue(value);
     }
     return value;
 }
@@ -283,27 +366,87 @@ std::string_view CDRDecoder::readStringView(size_t len) {
     return std::string_view(buffer, len - 1);
 }
 
-std::span<float> CDRDecoder::readSequenceSpanFloat() {
-    auto size = readUlong();
-    auto ptr = (float*)(_data + m_offset);
-    m_offset += size * 4z;
-    return std::span<float>(ptr, size);
-}
-std::vector<float> CDRDecoder::readSequenceVectorFloat() {
-    auto span = readSequenceSpanFloat();
-    return vector<float>(span.begin(), span.end());
+template <typename T>
+std::span<T> CDRDecoder::readSequenceSpan() {
+    size_t size = readUlong();
+    m_offset = (m_offset + sizeof(T) - 1) & ~(sizeof(T) - 1);
+    auto nbytes = size * sizeof(T);
+    if (m_offset + nbytes > length) {
+        throw std::out_of_range(format("out of range in CDRDecoder::readSequenceSpan(): offset {} + {} bytes > length {}", m_offset, nbytes, length));
+    }
+    auto ptr = _data + m_offset;
+    m_offset += nbytes;
+    if (size == 0) {
+        return {};
+    }
+    // the offset is aligned relative to the message, not the address
+    bool swap = sizeof(T) > 1 && std::endian::native != _endian;
+    if (!swap && reinterpret_cast<uintptr_t>(ptr) % alignof(T) == 0) {
+        return std::span<T>(reinterpret_cast<T *>(const_cast<char *>(ptr)), size);
+    }
+    // the received message might be shared, hence copy instead of swapping in place
+    std::shared_ptr<T[]> copy(new T[size]);
+    if (swap) {
+        detail::byteswap(copy.get(), ptr, size);
+    } else {
+        memcpy(copy.get(), ptr, nbytes);
+    }
+    copies.push_back(copy);
+    return std::span<T>(copy.get(), size);
 }
 
-std::span<double> CDRDecoder::readSequenceSpanDouble() {
-    auto size = readUlong();
-    align8();
-    auto ptr = (double*)(_data + m_offset);
-    m_offset += size * 8z;
-    return std::span<double>(ptr, size);
-}
-std::vector<double> CDRDecoder::readSequenceVectorDouble() {
-    auto span = readSequenceSpanDouble();
-    return vector<double>(span.begin(), span.end());
+template <typename T>
+std::vector<T> CDRDecoder::readSequenceVector() {
+    size_t size = readUlong();
+    m_offset = (m_offset + sizeof(T) - 1) & ~(sizeof(T) - 1);
+    auto nbytes = size * sizeof(T);
+    if (m_offset + nbytes > length) {
+        throw std::out_of_range(format("out of range in CDRDecoder::readSequenceVector(): offset {} + {} bytes > length {}", m_offset, nbytes, length));
+    }
+    std::vector<T> result(size);
+    if (size > 0) {
+        if (sizeof(T) > 1 && std::endian::native != _endian) {
+            detail::byteswap(result.data(), _data + m_offset, size);
+        } else {
+            memcpy(result.data(), _data + m_offset, nbytes);
+        }
+    }
+    m_offset += nbytes;
+    return result;
 }
 
+std::span<uint8_t> CDRDecoder::readSequenceSpanOctet() { return readSequenceSpan<uint8_t>(); }
+std::vector<uint8_t> CDRDecoder::readSequenceVectorOctet() { return readSequenceVector<uint8_t>(); }
+
+std::vector<bool> CDRDecoder::readSequenceVectorBoolean() {
+    size_t size = readUlong();
+    if (m_offset + size > length) {
+        throw std::out_of_range(format("out of range in CDRDecoder::readSequenceVectorBoolean(): offset {} + {} bytes > length {}", m_offset, size, length));
+    }
+    std::vector<bool> result(size);
+    auto ptr = _data + m_offset;
+    for (size_t i = 0; i < size; ++i) {
+        result[i] = ptr[i] != 0;
+    }
+    m_offset += size;
+    return result;
+}
+
+std::span<float> CDRDecoder::readSequenceSpanFloat() { return readSequenceSpan<float>(); }
+std::vector<float> CDRDecoder::readSequenceVectorFloat() { return readSequenceVector<float>(); }
+std::span<double> CDRDecoder::readSequenceSpanDouble() { return readSequenceSpan<double>(); }
+std::vector<double> CDRDecoder::readSequenceVectorDouble() { return readSequenceVector<double>(); }
+std::span<int16_t> CDRDecoder::readSequenceSpanShort() { return readSequenceSpan<int16_t>(); }
+std::vector<int16_t> CDRDecoder::readSequenceVectorShort() { return readSequenceVector<int16_t>(); }
+std::span<uint16_t> CDRDecoder::readSequenceSpanUshort() { return readSequenceSpan<uint16_t>(); }
+std::vector<uint16_t> CDRDecoder::readSequenceVectorUshort() { return readSequenceVector<uint16_t>(); }
+std::span<int32_t> CDRDecoder::readSequenceSpanLong() { return readSequenceSpan<int32_t>(); }
+std::vector<int32_t> CDRDecoder::readSequenceVectorLong() { return readSequenceVector<int32_t>(); }
+std::span<uint32_t> CDRDecoder::readSequenceSpanUlong() { return readSequenceSpan<uint32_t>(); }
+std::vector<uint32_t> CDRDecoder::readSequenceVectorUlong() { return readSequenceVector<uint32_t>(); }
+std::span<int64_t> CDRDecoder::readSequenceSpanLonglong() { return readSequenceSpan<int64_t>(); }
+std::vector<int64_t> CDRDecoder::readSequenceVectorLonglong() { return readSequenceVector<int64_t>(); }
+std::span<uint64_t> CDRDecoder::readSequenceSpanUlonglong() { return readSequenceSpan<uint64_t>(); }
+std::vector<uint64_t> CDRDecoder::readSequenceVectorUlonglong() { return readSequenceVector<uint64_t>(); }
+
 }  // namespace CORBA
@@ -9,6 +9,7 @@
 #include <memory>
 
 #include "blob.hh"
+#include "util/bufferpool.hh"
 
 namespace CORBA {
 
@@ -16,23 +17,87 @@ namespace CORBA {
 
 class CDREncoder {
     public:
-        std::unique_ptr<std::vector<char>> _data;
+        std::unique_ptr<detail::Buffer> _data;
+        /**
+         * large payloads referenced instead of being copied into _data,
+         * see writeBlobView() and writeSequenceView()
+         */
+        std::vector<detail::BufferSegment> segments;
+        /**
+         * offset within the encoded message, which is _data with the segments
+         * spliced in
+         */
         size_t offset = 0;
 
-         CDREncoder() {
-            _data = std::make_unique<std::vector<char>>();
-         }
+        CDREncoder() {
+            _data = std::make_unique<detail::Buffer>();
+        }
+        /**
+         * encode into a buffer drawn from pool, which the connection will
+         * return to the pool once it has been send
+         */
+        CDREncoder(detail::BufferPool *pool) {
+            _data = pool ? pool->acquire() : std::make_unique<detail::Buffer>();
+        }
+        /**
+         * like above but also reserve capacity for a message of sizeHint bytes
+         * so that encoding it does not need to reallocate
+         */
+        CDREncoder(detail::BufferPool *pool, size_t sizeHint) : CDREncoder(pool) { reserveHint(sizeHint); }
 
     protected:
         std::vector<size_t> sizeStack;
+        void appendSegment(const char *buffer, size_t nbytes);
+        template <typename T>
+        void writeSequenceOf(const T *values, size_t count);
+        /**
+         * number of bytes in segments
+         */
+        size_t external = 0;
+        /**
+         * message offset at which the last segment ends
+         */
+        size_t segmentsEnd = 0;
+        void grow(size_t nbytes);
+        size_t physicalBeforeSegments(size_t offset) const;
 
     public:
+        /**
+         * minimal capacity allocated on the first write
+         */
+        static constexpr size_t minCapacity = 256;
+        /**
+         * writeBlobView() and writeSequenceView() copy payloads smaller than this
+         */
+        static constexpr size_t minSegmentSize = 4096;
+
+        /**
+         * translate an offset within the message into an offset within _data
+         */
+        inline size_t physical(size_t offset) const {
+            if (offset >= segmentsEnd) {
+                return offset - external;
+            }
+            return physicalBeforeSegments(offset);
+        }
+
+        /**
+         * make the message at least nbytes long
+         */
         inline void reserve(size_t nbytes) {
-            if (_data->size() < nbytes) {
-                _data->resize(nbytes);
+            if (nbytes >= segmentsEnd && _data->size() < nbytes - external) {
+                grow(nbytes - external);
             }
         }
         inline void reserve() { reserve(offset); }
+        /**
+         * allocate capacity for nbytes without changing the length
+         */
+        inline void reserveHint(size_t nbytes) {
+            if (_data->capacity() < nbytes) {
+                _data->reserve(nbytes);
+            }
+        }
 
         void writeEndian();
         void writeBoolean(bool);
@@ -56,12 +121,45 @@ class CDREncoder {
 
         void writeSequence(const std::span<float> & value);
         void writeSequence(const std::span<double> & value);
+        /**
+         * sequences of the other primitive types, copied with a single memcpy
+         */
+        void writeSequence(std::span<const uint8_t> value);
+        void writeSequence(std::span<const int16_t> value);
+        void writeSequence(std::span<const uint16_t> value);
+        void writeSequence(std::span<const int32_t> value);
+        void writeSequence(std::span<const uint32_t> value);
+        void writeSequence(std::span<const int64_t> value);
+        void writeSequence(std::span<const uint64_t> value);
+        void writeSequence(const std::vector<bool> &value);
+
+        /**
+         * Like writeBlob() and writeSequence() but large payloads are not
+         * copied. Instead the encoder keeps a reference which is handed to the
+         * connection, which writes it with the same writev() as the rest of
+         * the message.
+         *
+         * The caller must keep the memory unchanged and valid until the
+         * message has been written, e.g. by awaiting the reply of a twoway call.
+         * Replies must not use this as the skeleton's return values are gone
+         * once the reply has been queued.
+         */
+        void writeBlobView(const char *buffer, size_t nbytes);
+        void writeSequenceView(const std::span<float> & value);
+        void writeSequenceView(const std::span<double> & value);
 
         void reserveSize();
         void fillInSize();
 
         const char *data() { return _data->data(); }
+        /**
+         * length of _data, which excludes the segments
+         */
         size_t length() { return _data->size(); }
+        /**
+         * length of the whole message
+         */
+        size_t size() const { return _data->size() + external; }
 
         void align2() {
             if (offset & 0x01) {
@@ -88,6 +186,10 @@ class CDRDecoder {
         size_t m_offset;
         size_t length;
         std::endian _endian;
+        /**
+         * sequences returned as span which could not refer into _data
+         */
+        std::vector<std::shared_ptr<void>> copies;
 
         CDRDecoder() : _data(nullptr), m_offset(0), length(0) {}
         CDRDecoder(const char *data, size_t length, std::endian endian = (std::endian)0) : _data(data), m_offset(0), length(length), _endian(endian) {}
@@ -114,10 +216,32 @@ class CDRDecoder {
         std::string_view readStringView();
         std::string_view readStringView(size_t length);
 
+        /**
+         * The span variants return the elements within the buffer without
+         * copying them when they are in our byte order and the buffer is
+         * suitably aligned. Otherwise they return a copy kept by the decoder.
+         *
+         * The vector variants copy the elements. Neither modifies the buffer.
+         */
         std::span<float> readSequenceSpanFloat();
         std::vector<float> readSequenceVectorFloat();
         std::span<double> readSequenceSpanDouble();
         std::vector<double> readSequenceVectorDouble();
+        std::span<int16_t> readSequenceSpanShort();
+        std::vector<int16_t> readSequenceVectorShort();
+        std::span<uint16_t> readSequenceSpanUshort();
+        std::vector<uint16_t> readSequenceVectorUshort();
+        std::span<int32_t> readSequenceSpanLong();
+        std::vector<int32_t> readSequenceVectorLong();
+        std::span<uint32_t> readSequenceSpanUlong();
+        std::vector<uint32_t> readSequenceVectorUlong();
+        std::span<int64_t> readSequenceSpanLonglong();
+        std::vector<int64_t> readSequenceVectorLonglong();
+        std::span<uint64_t> readSequenceSpanUlonglong();
+        std::vector<uint64_t> readSequenceVectorUlonglong();
+        std::span<uint8_t> readSequenceSpanOctet();
+        std::vector<uint8_t> readSequenceVectorOctet();
+        std::vector<bool> readSequenceVectorBoolean();
 
         // sequence
         // value
@@ -151,6 +275,11 @@ class CDRDecoder {
         }
 
     protected:
+        template <typename T>
+        std::span<T> readSequenceSpan();
+        template <typename T>
+        std::vector<T> readSequenceVector();
+
         const char *ptr2() {
             align2();
             auto ptr = _data + m_offset;
@@ -0,0 +1,80 @@
+#include "cdrstream.hh"
+
+#include <format>
+#include <stdexcept>
+
+using namespace std;
+
+namespace CORBA {
+
+void CDRStreamDecoder::append(unique_ptr<detail::Buffer> &&buffer, size_t begin) {
+    if (begin >= buffer->size()) {
+        return;
+    }
+    auto size = buffer->size() - begin;
+    chunks.push_back({std::move(buffer), begin, length});
+    length += size;
+}
+
+unique_ptr<detail::Buffer> CDRStreamDecoder::join() {
+    size_t begin = chunks.empty() ? 0 : chunks.front().position;
+    auto result = make_unique<detail::Buffer>(length - begin);
+    for (auto &chunk : chunks) {
+        memcpy(result->data() + chunk.position - begin, chunk.data(), chunk.size());
+        chunk.buffer.reset();
+    }
+    chunks.clear();
+    current = 0;
+    m_offset = 0;
+    length = 0;
+    return result;
+}
+
+void CDRStreamDecoder::discard() {
+    size_t n = 0;
+    while (n < chunks.size() && chunks[n].position + chunks[n].size() <= m_offset) {
+        ++n;
+    }
+    chunks.erase(chunks.begin(), chunks.begin() + n);
+    current = current > n ? current - n : 0;
+}
+
+void CDRStreamDecoder::seek() {
+    // reading only moves forward, hence start at the current chunk unless we went back
+    if (current < chunks.size() && m_offset < chunks[current].position) {
+        current = 0;
+    }
+    while (current + 1 < chunks.size() && m_offset >= chunks[current].position + chunks[current].size()) {
+        ++current;
+    }
+}
+
+span<const char> CDRStreamDecoder::contiguous() {
+    if (m_offset >= length) {
+        return {};
+    }
+    if (m_offset < chunks.front().position) {
+        throw out_of_range(format("out of range in CDRStreamDecoder::contiguous(): offset {} has been discarded", m_offset));
+    }
+    seek();
+    auto &chunk = chunks[current];
+    auto offset = m_offset - chunk.position;
+    return span<const char>(chunk.data() + offset, chunk.size() - offset);
+}
+
+void CDRStreamDecoder::read(void *destination, size_t size) {
+    if (m_offset + size > length) {
+        throw out_of_range(format("out of range in CDRStreamDecoder::read(): offset {} + size {} > received {}", m_offset, size, length));
+    }
+    auto out = static_cast<char *>(destination);
+    while (size) {
+        auto piece = contiguous();
+        auto n = min(size, piece.size());
+        memcpy(out, piece.data(), n);
+        out += n;
+        size -= n;
+        m_offset += n;
+    }
+}
+
+}  // namespace CORBA
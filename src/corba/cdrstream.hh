@@ -0,0 +1,201 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+#include "util/buffer.hh"
+#include "util/byteswap.hh"
+
+namespace CORBA {
+
+/**
+ * Decodes CDR from a chain of buffers (a rope) which grows while the data is
+ * still arriving, e.g. the fragments of a large GIOP 1.2 message.
+ *
+ * Offsets and alignment are relative to the start of the message, just as
+ * with CDRDecoder, so decoding continues seamlessly where the message was
+ * split. Reading beyond the data received so far throws std::out_of_range,
+ * check available() first or use a SequenceReader.
+ */
+class CDRStreamDecoder {
+        struct Chunk {
+                std::unique_ptr<detail::Buffer> buffer;
+                /**
+                 * first byte within buffer which belongs to the message
+                 */
+                size_t begin;
+                /**
+                 * offset of the chunk's first byte within the message
+                 */
+                size_t position;
+                const char *data() const { return buffer->data() + begin; }
+                size_t size() const { return buffer->size() - begin; }
+        };
+        std::vector<Chunk> chunks;
+        /**
+         * chunk containing m_offset
+         */
+        size_t current = 0;
+        size_t m_offset = 0;
+        size_t length = 0;
+
+        void seek();
+
+    public:
+        std::endian _endian;
+
+        CDRStreamDecoder(std::endian endian = std::endian::native) : _endian(endian) {}
+
+        /**
+         * append the bytes of buffer starting at begin to the message
+         */
+        void append(std::unique_ptr<detail::Buffer> &&buffer, size_t begin = 0);
+        /**
+         * move the received chunks into a single buffer, each chunk is freed
+         * once it has been copied and the decoder is empty afterwards
+         */
+        std::unique_ptr<detail::Buffer> join();
+        /**
+         * free the chunks which have been read completely, reading before
+         * them throws std::out_of_range afterwards
+         */
+        void discard();
+
+        /**
+         * number of bytes received so far
+         */
+        inline size_t size() const { return length; }
+        /**
+         * number of received bytes which have not been discarded
+         */
+        inline size_t buffered() const { return chunks.empty() ? 0 : length - chunks.front().position; }
+        /**
+         * number of received bytes not read yet
+         */
+        inline size_t available() const { return length > m_offset ? length - m_offset : 0; }
+        /**
+         * true when a value of the given size and alignment has been received
+         */
+        inline bool available(size_t size, size_t alignment) const { return ((m_offset + alignment - 1) & ~(alignment - 1)) + size <= length; }
+
+        inline size_t getOffset() const { return m_offset; }
+        inline void setOffset(size_t offset) { m_offset = offset; }
+        inline void skip(size_t size) { m_offset += size; }
+        inline void setLittleEndian(bool little) { _endian = little ? std::endian::little : std::endian::big; }
+        void align2() { m_offset = (m_offset + 1) & ~1z; }
+        void align4() { m_offset = (m_offset + 3) & ~3z; }
+        void align8() { m_offset = (m_offset + 7) & ~7z; }
+
+        /**
+         * the received bytes from the current offset up to the end of their
+         * chunk, they are not consumed
+         */
+        std::span<const char> contiguous();
+        /**
+         * copy size bytes, which may span several chunks, to destination
+         */
+        void read(void *destination, size_t size);
+
+        template <typename T>
+        T read() {
+            m_offset = (m_offset + alignof(T) - 1) & ~(alignof(T) - 1);
+            T value;
+            read(&value, sizeof(T));
+            return _endian == std::endian::native ? value : detail::byteswapValue(value);
+        }
+
+        bool readBoolean() { return read<uint8_t>() != 0; }
+        uint8_t readOctet() { return read<uint8_t>(); }
+        uint16_t readUshort() { return read<uint16_t>(); }
+        uint32_t readUlong() { return read<uint32_t>(); }
+        uint64_t readUlonglong() { return read<uint64_t>(); }
+        int16_t readShort() { return read<int16_t>(); }
+        int32_t readLong() { return read<int32_t>(); }
+        int64_t readLonglong() { return read<int64_t>(); }
+        float readFloat() { return read<float>(); }
+        double readDouble() { return read<double>(); }
+};
+
+/**
+ * Reads a sequence from a CDRStreamDecoder while it's data is still arriving.
+ *
+ * Each call of read() hands the elements received since the previous call to
+ * the callback, in as few spans as the chunks allow. The elements are passed
+ * without copying unless they need to be byte swapped, are misaligned or
+ * straddle two chunks.
+ *
+ * T is a numeric type or a struct of octets, e.g. an RGBA pixel.
+ */
+template <typename T>
+    requires std::is_arithmetic_v<T> || (std::is_trivially_copyable_v<T> && alignof(T) == 1)
+class SequenceReader {
+        std::optional<uint32_t> count;
+        uint32_t done = 0;
+        std::vector<T> scratch;
+
+    public:
+        /**
+         * the number of elements once the sequence's length has been received
+         */
+        std::optional<uint32_t> size() const { return count; }
+        /**
+         * the number of elements handed to the callback so far
+         */
+        uint32_t received() const { return done; }
+        bool complete() const { return count && done == *count; }
+
+        /**
+         * \return true once all elements have been read
+         */
+        bool read(CDRStreamDecoder &in, const std::function<void(std::span<const T>)> &elements) {
+            if (!count) {
+                if (!in.available(4, 4)) {
+                    return false;
+                }
+                count = in.readUlong();
+                if (*count != 0) {
+                    in.setOffset((in.getOffset() + alignof(T) - 1) & ~(alignof(T) - 1));
+                }
+            }
+            while (done < *count) {
+                auto piece = in.contiguous();
+                size_t n = std::min<size_t>(piece.size() / sizeof(T), *count - done);
+                if (n == 0) {
+                    if (in.available() < sizeof(T)) {
+                        break;
+                    }
+                    // the element straddles two chunks
+                    T element = in.read<T>();
+                    elements(std::span<const T>(&element, 1));
+                    ++done;
+                    continue;
+                }
+                auto ptr = piece.data();
+                if (in._endian == std::endian::native && reinterpret_cast<uintptr_t>(ptr) % alignof(T) == 0) {
+                    elements(std::span<const T>(reinterpret_cast<const T *>(ptr), n));
+                } else {
+                    scratch.resize(n);
+                    memcpy(scratch.data(), ptr, n * sizeof(T));
+                    if constexpr (std::is_arithmetic_v<T>) {
+                        if (in._endian != std::endian::native) {
+                            detail::byteswap(scratch.data(), scratch.data(), n);
+                        }
+                    }
+                    elements(std::span<const T>(scratch.data(), n));
+                }
+                in.skip(n * sizeof(T));
+                done += n;
+            }
+            return done == *count;
+        }
+};
+
+}  // namespace CORBA
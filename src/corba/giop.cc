@@ -17,6 +17,15 @@ using namespace std;
 
 namespace CORBA {
 
+// the buffer pool belongs to the thread owning the connection
+static detail::BufferPool *poolOf(detail::Connection *connection) {
+    return connection && connection->isOwnerThread() ? &connection->bufferPool : nullptr;
+}
+
+GIOPEncoder::GIOPEncoder(detail::Connection* connection) : GIOPBase(connection), buffer(poolOf(connection)) {}
+GIOPEncoder::GIOPEncoder(detail::Connection* connection, size_t sizeHint)
+    : GIOPBase(connection), buffer(poolOf(connection), sizeHint) {}
+
 void GIOPEncoder::writeObject(const CORBA::Object* object) {
     // cerr << "GIOPEncoder::object(...)" << endl;
     if (object == nullptr) {
@@ -249,6 +258,7 @@ MessageType GIOPDecoder::scanGIOPHeader() {
     minorVersion = readOctet();
     auto flags = readOctet();
     buffer.setLittleEndian(flags & 1);
+    moreFragments = flags & 2;
     m_type = static_cast<MessageType>(readOctet());
     m_length = readUlong();
     return m_type;
@@ -359,10 +369,9 @@ void GIOPDecoder::readServiceContext() {
                         auto host = readStringView();
                         auto port = readUshort();
                         if (host != connection->remote.host && port != connection->remote.port) {
-                            // is there a map???
                             cout << "    switch remote from " << connection->remote.str();
-                            connection->remote.host = host;
-                            connection->remote.port = port;
+                            // also moves the connection within the ORB's connection pool
+                            connection->setRemote(host, port);
                             cout << "  to " << connection->remote.str() << endl;
                         }
                     }
@@ -5,6 +5,7 @@
 #include <functional>
 #include <memory>
 #include <string>
+#include <type_traits>
 
 #include "cdr.hh"
 
@@ -167,7 +168,14 @@ class GIOPBase {
 
 class GIOPEncoder : public GIOPBase {
     public:
-        GIOPEncoder(detail::Connection *connection = nullptr) : GIOPBase(connection) { this->connection = connection; }
+        /**
+         * when a connection is provided, the encoder's buffer is drawn from the connection's buffer pool
+         */
+        GIOPEncoder(detail::Connection *connection = nullptr);
+        /**
+         * like above but reserve space for sizeHint bytes upfront
+         */
+        GIOPEncoder(detail::Connection *connection, size_t sizeHint);
 
         CDREncoder buffer;
         inline void writeBoolean(bool value) { buffer.writeBoolean(value); }
@@ -194,9 +202,28 @@ class GIOPEncoder : public GIOPBase {
 
         inline void writeSequence(const std::span<float> & value) { buffer.writeSequence(value); }
         inline void writeSequence(const std::span<double> & value) { buffer.writeSequence(value); }
+        inline void writeSequence(std::span<const uint8_t> value) { buffer.writeSequence(value); }
+        inline void writeSequence(std::span<const int16_t> value) { buffer.writeSequence(value); }
+        inline void writeSequence(std::span<const uint16_t> value) { buffer.writeSequence(value); }
+        inline void writeSequence(std::span<const int32_t> value) { buffer.writeSequence(value); }
+        inline void writeSequence(std::span<const uint32_t> value) { buffer.writeSequence(value); }
+        inline void writeSequence(std::span<const int64_t> value) { buffer.writeSequence(value); }
+        inline void writeSequence(std::span<const uint64_t> value) { buffer.writeSequence(value); }
+        inline void writeSequence(const std::vector<bool> &value) { buffer.writeSequence(value); }
+
+        // see CDREncoder::writeBlobView() for the lifetime requirements
+        inline void writeBlobView(const char *value, size_t size) { buffer.writeBlobView(value, size); }
+        inline void writeBlobView(const CORBA::blob_view &value) { buffer.writeBlobView((const char*)value.data(), value.size()); }
+        inline void writeSequenceView(const std::span<float> & value) { buffer.writeSequenceView(value); }
+        inline void writeSequenceView(const std::span<double> & value) { buffer.writeSequenceView(value); }
         
-        template <class T>
-        void writeSequence(const std::vector<T> & value, std::function<void(const T &)> writeElement) {
+        /**
+         * writeElement is called with each element, e.g. to encode the
+         * members of a struct. it is a template parameter instead of a
+         * std::function so that it can be inlined.
+         */
+        template <class T, typename F>
+        void writeSequence(const std::vector<T> & value, F &&writeElement) {
             buffer.writeUlong(value.size());
             for(auto &item: value) {
                writeElement(item);
@@ -229,6 +256,10 @@ class GIOPDecoder : public GIOPBase {
         CDRDecoder &buffer;
         MessageType m_type;
         size_t m_length;
+        /**
+         * GIOP 1.2: the message is continued by FRAGMENT messages
+         */
+        bool moreFragments = false;
 
         uint32_t requestId;
         ReplyStatus replyStatus;
@@ -274,11 +305,34 @@ class GIOPDecoder : public GIOPBase {
         inline std::vector<float> readSequenceVectorFloat() {return buffer.readSequenceVectorFloat(); }
         inline std::span<double> readSequenceSpanDouble() { return buffer.readSequenceSpanDouble(); }
         inline std::vector<double> readSequenceVectorDouble() {return buffer.readSequenceVectorDouble(); }
-
-        template<class T>
-        inline std::vector<T> readSequence(std::function<T()> readElement) {
+        inline std::span<int16_t> readSequenceSpanShort() { return buffer.readSequenceSpanShort(); }
+        inline std::vector<int16_t> readSequenceVectorShort() { return buffer.readSequenceVectorShort(); }
+        inline std::span<uint16_t> readSequenceSpanUshort() { return buffer.readSequenceSpanUshort(); }
+        inline std::vector<uint16_t> readSequenceVectorUshort() { return buffer.readSequenceVectorUshort(); }
+        inline std::span<int32_t> readSequenceSpanLong() { return buffer.readSequenceSpanLong(); }
+        inline std::vector<int32_t> readSequenceVectorLong() { return buffer.readSequenceVectorLong(); }
+        inline std::span<uint32_t> readSequenceSpanUlong() { return buffer.readSequenceSpanUlong(); }
+        inline std::vector<uint32_t> readSequenceVectorUlong() { return buffer.readSequenceVectorUlong(); }
+        inline std::span<int64_t> readSequenceSpanLonglong() { return buffer.readSequenceSpanLonglong(); }
+        inline std::vector<int64_t> readSequenceVectorLonglong() { return buffer.readSequenceVectorLonglong(); }
+        inline std::span<uint64_t> readSequenceSpanUlonglong() { return buffer.readSequenceSpanUlonglong(); }
+        inline std::vector<uint64_t> readSequenceVectorUlonglong() { return buffer.readSequenceVectorUlonglong(); }
+        inline std::span<uint8_t> readSequenceSpanOctet() { return buffer.readSequenceSpanOctet(); }
+        inline std::vector<uint8_t> readSequenceVectorOctet() { return buffer.readSequenceVectorOctet(); }
+        inline std::vector<bool> readSequenceVectorBoolean() { return buffer.readSequenceVectorBoolean(); }
+
+        /**
+         * readElement decodes one element, see GIOPEncoder::writeSequence()
+         *
+         * the element type defaults to what readElement returns, so that
+         * readSequence(std::function<T()>) and readSequence([&] { ... })
+         * work without spelling out T
+         */
+        template<class T = void, typename F>
+        inline auto readSequence(F &&readElement) {
+            using E = std::conditional_t<std::is_void_v<T>, std::remove_cvref_t<std::invoke_result_t<F &>>, T>;
             auto size = readUlong();
-            std::vector<T> out;
+            std::vector<E> out;
             out.reserve(size);
             for(uint32_t i=0; i<size; ++i) { out.emplace_back(readElement()); }
             return out;
@@ -47,15 +47,14 @@ void NamingContextExtImpl::_orb_resolve_str(GIOPDecoder &decoder, GIOPEncoder &e
 }
 
 async<> NamingContextExtImpl::_dispatch(const std::string_view &operation, GIOPDecoder &decoder, GIOPEncoder &encoder) {
-    // cerr << "NamingContextExtImpl::_call(" << operation << ", ...)"
-    // << endl;
-    if (operation == "resolve") {
-        _orb_resolve(decoder, encoder);
-        co_return;
-    }
-    if (operation == "resolve_str") {
-        _orb_resolve_str(decoder, encoder);
-        co_return;
+    static constexpr detail::OperationTable _operations({"resolve", "resolve_str"});
+    switch (_operations.find(operation)) {
+        case 0:
+            _orb_resolve(decoder, encoder);
+            co_return;
+        case 1:
+            _orb_resolve_str(decoder, encoder);
+            co_return;
     }
     // TODO: throw a BAD_OPERATION system exception here
     throw std::runtime_error(std::format("bad operation: '{}' does not exist", operation));
@@ -69,7 +68,8 @@ async<std::shared_ptr<IOR>> NamingContextExtStub::resolve_str(const std::string
         },
         [](GIOPDecoder &decoder) {
             return decoder.readReference();
-        });
+        },
+        4 + name.size() + 1);
 }
 
 // FIXME: OmniORB want's "IDL:omg.org/CosNaming/NamingContext:1.0", but also "IDL:omg.org/CosNaming/NamingContextExt:1.0" possible
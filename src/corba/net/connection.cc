@@ -1,8 +1,12 @@
 #include "connection.hh"
 #include "protocol.hh"
+#include "../giop.hh"
 #include "../stub.hh"
 #include "../util/logger.hh"
 
+#include <bit>
+#include <cstring>
+
 namespace CORBA {
 
 namespace detail {
@@ -11,6 +15,9 @@ namespace detail {
 //       what's the supposed behaviour when it disappears???
 Connection::~Connection() {
     std::println("Connection::~Connection()");
+    if (owner) {
+        --owner->connections;
+    }
     // free stubs which are owned by the connection itself...
     // nameServiceStubs.clear();
     if (!stubsById.empty()) {
@@ -22,53 +29,406 @@ Connection::~Connection() {
 }
 Protocol::~Protocol() {}
 
-std::string Connection::str() const { 
+struct ev_loop *Connection::loop() const { return owner ? owner->loop : protocol->loop; }
+
+bool Connection::isOwnerThread() const { return owner ? owner->isCurrent() : EventLoop::current() == nullptr; }
+
+void Connection::post(std::function<void()> &&task) {
+    if (isOwnerThread()) {
+        task();
+    } else if (owner) {
+        owner->post(std::move(task));
+    } else {
+        EventLoop::current()->home->post(std::move(task));
+    }
+}
+
+TimerWheel &Connection::timers() {
+    if (!wheel) {
+        wheel = &TimerWheel::of(loop());
+    }
+    return *wheel;
+}
+
+void Connection::close() {
+    closed = true;
+    if (state != ConnectionState::ESTABLISHED) {
+        return;
+    }
+    send(closeConnection());
+}
+
+std::unique_ptr<Buffer> Connection::closeConnection() {
+    // the message consists of the GIOP header only
+    GIOPEncoder encoder(this);
+    encoder.buffer.offset = 12;
+    encoder.setGIOPHeader(MessageType::CLOSE_CONNECTION);
+    return std::move(encoder.buffer._data);
+}
+
+std::unique_ptr<Buffer> Connection::reassemble(uint32_t requestId, bool fragment, bool moreFragments, const char *data, size_t size) {
+    if (!fragment) {
+        auto &entry = fragmented[requestId];
+        entry = Fragmented();
+        entry.message.append(std::make_unique<Buffer>(data, data + size));
+        return std::unique_ptr<Buffer>();
+    }
+    auto p = fragmented.find(requestId);
+    if (p == fragmented.end()) {
+        Logger::error("{}: dropping fragment of unknown request {}", str(), requestId);
+        return std::unique_ptr<Buffer>();
+    }
+    auto &entry = p->second;
+    if (!entry.error) {
+        // skip the GIOP header and the fragment header
+        entry.message.append(std::make_unique<Buffer>(data, data + size), 16);
+    }
+    if (entry.stream && !entry.error) {
+        pass(requestId, entry, !moreFragments);
+    }
+    if (moreFragments) {
+        return std::unique_ptr<Buffer>();
+    }
+    if (entry.streamed) {
+        auto streamed = std::move(entry.streamed);
+        auto error = entry.error;
+        fragmented.erase(p);
+        streamed(error);
+        return std::unique_ptr<Buffer>();
+    }
+    auto message = entry.message.join();
+    fragmented.erase(p);
+
+    // turn it into a single message
+    auto header = reinterpret_cast<GIOPHeader *>(message->data());
+    header->endian &= ~2;
+    uint32_t length = message->size() - sizeof(GIOPHeader);
+    if (static_cast<bool>(header->endian & 1) != (std::endian::native == std::endian::little)) {
+        length = std::byteswap(length);
+    }
+    memcpy(&header->length, &length, sizeof(length));
+    return message;
+}
+
+size_t Connection::fragmentedBytes() const {
+    size_t result = 0;
+    for (auto &[requestId, entry] : fragmented) {
+        result += entry.message.buffered();
+    }
+    return result;
+}
+
+void Connection::stream(uint32_t requestId, size_t offset, std::function<void(CDRStreamDecoder &, bool last)> &&handler,
+                        std::function<void(std::exception_ptr)> &&streamed) {
+    auto p = fragmented.find(requestId);
+    if (p == fragmented.end()) {
+        return;
+    }
+    auto &entry = p->second;
+    auto header = reinterpret_cast<const GIOPHeader *>(entry.message.contiguous().data());
+    entry.message.setLittleEndian(header->endian & 1);
+    entry.message.setOffset(offset);
+    entry.stream = std::move(handler);
+    entry.streamed = std::move(streamed);
+    pass(requestId, entry, false);
+}
+
+/**
+ * hand the fragments received so far to the stream handler and free those it
+ * has read
+ */
+void Connection::pass(uint32_t requestId, Fragmented &entry, bool last) {
+    try {
+        entry.stream(entry.message, last);
+        entry.message.discard();
+    } catch (std::exception &ex) {
+        Logger::error("{}: streaming request {} failed: {}", str(), requestId, ex.what());
+        entry.error = std::current_exception();
+        entry.stream = nullptr;
+        entry.message = CDRStreamDecoder();
+    }
+}
+
+void Connection::startIdleTimer() {
+    auto pool = this->pool.load();
+    if (!pool || pool->idleTimeout.count() == 0) {
+        return;
+    }
+    auto timeout = std::chrono::duration<double>(pool->idleTimeout).count();
+    post([self = shared_from_this(), timeout] { self->timers().start(self->idleTimer, timeout); });
+}
+
+void Connection::checkIdle() {
+    auto pool = this->pool.load();
+    // a closed connection restarts the timer once it is used again
+    if (!pool || closed) {
+        return;
+    }
+    auto timeout = pool->idleTimeout;
+    auto elapsed = std::chrono::steady_clock::now() - lastActivity.load();
+    if (!inUse() && elapsed >= timeout) {
+        pool->evict(this);
+        return;
+    }
+    // look again once the connection might have become idle for long enough
+    std::chrono::steady_clock::duration remaining = timeout;
+    if (!inUse()) {
+        remaining -= elapsed;
+    }
+    timers().start(idleTimer, std::chrono::duration<double>(remaining).count());
+}
+
+void Connection::sendv(std::unique_ptr<Buffer> &&buffer, std::vector<BufferSegment> &&segments) {
+    if (segments.empty()) {
+        send(std::move(buffer));
+    } else {
+        send(flatten(std::move(buffer), std::move(segments)));
+    }
+}
+
+std::unique_ptr<Buffer> Connection::flatten(std::unique_ptr<Buffer> &&buffer, std::vector<BufferSegment> &&segments) {
+    if (segments.empty()) {
+        return std::move(buffer);
+    }
+    size_t size = buffer->size();
+    for (auto &segment : segments) {
+        size += segment.size;
+    }
+    // the buffer pool belongs to the thread owning the connection
+    bool pooled = isOwnerThread();
+    auto flat = pooled ? bufferPool.acquire() : std::make_unique<Buffer>();
+    flat->reserve(size);
+    size_t position = 0;
+    for (auto &segment : segments) {
+        flat->insert(flat->end(), buffer->data() + position, buffer->data() + segment.position);
+        flat->insert(flat->end(), segment.data, segment.data + segment.size);
+        position = segment.position;
+    }
+    flat->insert(flat->end(), buffer->data() + position, buffer->data() + buffer->size());
+    if (pooled) {
+        bufferPool.release(std::move(buffer));
+    }
+    segments.clear();
+    return flat;
+}
+
+void Connection::setRemote(std::string_view host, uint16_t port) {
+    auto pool = this->pool.load();
+    if (pool) {
+        pool->setRemote(this, host, port);
+    } else {
+        remote.host = host;
+        remote.port = port;
+    }
+}
+
+std::string Connection::str() const {
     if (protocol) {
         return protocol->local.str() + " -> " + remote.str();
     }
     return "null -> " + remote.str();
 }
 
-// auto cmp = [](Connection *a, Connection *b) {
-//     if (a->remote.port < b->remote.port) {
-//         return true;
-//     }
-//     if (a->remote.port == b->remote.port) {
-//         return a->remote.host < b->remote.host;
-//     }
-//     return false;
-// };
+void ConnectionPool::add(Index &index, const HostAndPort &key, Connection *connection) { index[key].insert(connection); }
 
-std::shared_ptr<Connection> ConnectionPool::findByLocal(const char *host, uint16_t port) const {
-    for (auto &c : connections) {
-        if (c->protocol->local.host == host && c->protocol->local.port == port) {
-            return c;
+void ConnectionPool::remove(Index &index, const HostAndPort &key, Connection *connection) {
+    auto p = index.find(endpoint(key));
+    if (p == index.end()) {
+        return;
+    }
+    p->second.erase(connection);
+    if (p->second.empty()) {
+        index.erase(p);
+    }
+}
+
+std::shared_ptr<Connection> ConnectionPool::find(const Index &index, const char *host, uint16_t port) {
+    auto p = index.find(Endpoint{host, port});
+    if (p == index.end()) {
+        return std::shared_ptr<Connection>();
+    }
+    return (*p->second.begin())->shared_from_this();
+}
+
+void ConnectionPool::insert(std::shared_ptr<Connection> conn) {
+    // destroy the connections outside of the lock
+    std::vector<std::shared_ptr<Connection>> unused;
+    std::shared_ptr<Connection> victim;
+    {
+        std::lock_guard lock(mutex);
+        auto [entry, inserted] = connections.emplace(conn.get(), Entry{conn, conn->protocol ? conn->protocol->local : HostAndPort()});
+        if (inserted) {
+            conn->pool = this;
+            add(byRemote, conn->remote, conn.get());
+            add(byLocal, entry->second.local, conn.get());
+        }
+        if (maxConnections != 0) {
+            size_t open = 0;
+            for (auto p = connections.begin(); p != connections.end();) {
+                auto &c = p->second.connection;
+                if (!c->closed) {
+                    ++open;
+                    if (c != conn && !c->inUse() && (!victim || c->lastActivity.load() < victim->lastActivity.load())) {
+                        victim = c;
+                    }
+                } else if (c.use_count() == 1) {
+                    // closed earlier and no stub refers to it anymore
+                    unused.push_back(c);
+                    erase(p++);
+                    continue;
+                }
+                ++p;
+            }
+            if (open <= maxConnections) {
+                victim.reset();
+            } else if (!victim) {
+                Logger::debug("ConnectionPool::insert(): {} open connections exceed the maximum of {} but all of them are in use", open, maxConnections);
+            }
         }
     }
-    Logger::debug("ConnectionPool::findByLocal({}, {}): found no connection", host, port);
-    for (auto &c : connections) {
-        Logger::debug("ConnectionPool::findByLocal(): HAVE {}:{} == {}:{} ?", host, port, c->remote.host, c->remote.port);
+    conn->startIdleTimer();
+    if (victim) {
+        Logger::debug("ConnectionPool::insert(): evict least recently used connection {}", victim->str());
+        auto connection = victim.get();
+        victim.reset();
+        evict(connection);
     }
-    return std::shared_ptr<Connection>();
 }
 
-std::shared_ptr<Connection> ConnectionPool::findByRemote(const char *host, uint16_t port) const {
-    for (auto &c : connections) {
-        // std::println("ConnectionPool::find(): {}:{} == {}:{} ?", host, port, c->remote.host, c->remote.port);
-        if (c->remote.host == host && c->remote.port == port) {
-            return c;
+void ConnectionPool::erase(std::unordered_map<Connection *, Entry>::iterator entry) {
+    auto connection = entry->first;
+    remove(byRemote, connection->remote, connection);
+    remove(byLocal, entry->second.local, connection);
+    connection->pool = nullptr;
+    connections.erase(entry);
+}
+
+void ConnectionPool::erase(std::shared_ptr<Connection> conn) {
+    std::lock_guard lock(mutex);
+    auto entry = connections.find(conn.get());
+    if (entry != connections.end()) {
+        erase(entry);
+    }
+}
+
+/**
+ * get connection's shared_ptr and drop it from the pool when the pool is it's
+ * only owner
+ */
+std::shared_ptr<Connection> ConnectionPool::release(Connection *connection) {
+    std::lock_guard lock(mutex);
+    auto entry = connections.find(connection);
+    if (entry == connections.end()) {
+        return std::shared_ptr<Connection>();
+    }
+    auto result = entry->second.connection;
+    if (result.use_count() == 2) {
+        erase(entry);
+    }
+    return result;
+}
+
+void ConnectionPool::evict(Connection *connection) {
+    auto conn = release(connection);
+    if (conn) {
+        {
+            std::lock_guard lock(mutex);
+            ++evicted;
+        }
+        conn->close();
+    }
+}
+
+void ConnectionPool::close(Connection *connection) {
+    auto conn = release(connection);
+    if (conn) {
+        conn->close();
+    } else {
+        connection->close();
+    }
+}
+
+void ConnectionPool::setRemote(Connection *connection, std::string_view host, uint16_t port) {
+    std::lock_guard lock(mutex);
+    bool indexed = connections.contains(connection);
+    if (indexed) {
+        remove(byRemote, connection->remote, connection);
+    }
+    connection->remote.host = host;
+    connection->remote.port = port;
+    if (indexed) {
+        add(byRemote, connection->remote, connection);
+    }
+}
+
+void ConnectionPool::clear() {
+    // destroy the connections outside of the lock
+    std::unordered_map<Connection *, Entry> closed;
+    {
+        std::lock_guard lock(mutex);
+        closed.swap(connections);
+        byRemote.clear();
+        byLocal.clear();
+    }
+    for (auto &[c, entry] : closed) {
+        c->pool = nullptr;
+    }
+}
+
+ConnectionPool::Stats ConnectionPool::stats() const {
+    std::lock_guard lock(mutex);
+    Stats result;
+    result.evicted = evicted;
+    for (auto &[c, entry] : connections) {
+        if (c->closed) {
+            continue;
         }
+        ++result.open;
+        if (!c->inUse()) {
+            ++result.idle;
+        } else {
+            ++result.inUse;
+        }
+    }
+    return result;
+}
+
+std::shared_ptr<Connection> ConnectionPool::findByLocal(const char *host, uint16_t port) const {
+    std::lock_guard lock(mutex);
+    auto c = find(byLocal, host, port);
+    if (!c) {
+        Logger::debug("ConnectionPool::findByLocal({}, {}): found no connection", host, port);
+    }
+    return c;
+}
+
+std::shared_ptr<Connection> ConnectionPool::findByRemote(const char *host, uint16_t port) const {
+    std::lock_guard lock(mutex);
+    auto c = find(byRemote, host, port);
+    if (!c) {
+        Logger::debug("ConnectionPool::findByRemote({}, {}): found no connection", host, port);
     }
-    Logger::debug("ConnectionPool::findByRemote({}, {}): found no connection", host, port);
-    for (auto &c : connections) {
-        Logger::debug("ConnectionPool::findByRemote(): HAVE {}:{} == {}:{} ?", host, port, c->remote.host, c->remote.port);
+    return c;
+}
+
+std::vector<std::shared_ptr<Connection>> ConnectionPool::findAllByRemote(const char *host, uint16_t port) const {
+    std::vector<std::shared_ptr<Connection>> result;
+    std::lock_guard lock(mutex);
+    auto p = byRemote.find(Endpoint{host, port});
+    if (p != byRemote.end()) {
+        for (auto c : p->second) {
+            result.push_back(c->shared_from_this());
+        }
     }
-    return std::shared_ptr<Connection>();
+    return result;
 }
 
 void ConnectionPool::print() const {
-    for (auto &c : connections) {
-        println("{}", c->str());
+    std::lock_guard lock(mutex);
+    for (auto &[c, entry] : connections) {
+        auto &stats = c->bufferPool.stats();
+        println("{} (receive buffer: {} bytes, send buffer pool: {} hits, {} misses, {} returned, {} discarded)", c->str(), c->receiveBufferBytes(),
+                stats.hits, stats.misses, stats.returned, stats.discarded);
     }
 }
 
@@ -1,10 +1,13 @@
 #pragma once
 
 #include <atomic>
+#include <chrono>
 #include <map>
 #include <mutex>
-#include <set>
 #include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 #include <memory>
 #include <utility>
@@ -12,7 +15,12 @@
 #include <exception>
 
 #include "../blob.hh"
+#include "../cdrstream.hh"
 #include "../coroutine.hh"
+#include "../util/bufferpool.hh"
+#include "../util/requesttable.hh"
+#include "eventloop.hh"
+#include "timerwheel.hh"
 #include "util/socket.hh"
 
 namespace CORBA {
@@ -24,6 +32,7 @@ class GIOPDecoder;
 namespace detail {
 
 class Protocol;
+class ConnectionPool;
 
 enum class ConnectionState {
     /**
@@ -44,39 +53,211 @@ enum class ConnectionState {
     ESTABLISHED
 };
 
-class Connection {
+class Connection : public std::enable_shared_from_this<Connection> {
         friend class CORBA::ORB;
+        friend class ConnectionPool;
+
+        /**
+         * the pool the connection has been inserted into
+         */
+        std::atomic<ConnectionPool *> pool = nullptr;
+        /**
+         * closes the connection after ConnectionPool::idleTimeout without traffic
+         */
+        TimerWheel::Timer idleTimer;
+        void startIdleTimer();
+        void checkIdle();
+
     protected:
 
         /**
-         * for suspending coroutines via co_await interlock.suspend(requestId)
+         * for suspending coroutines via co_await outstanding.suspend(requestId)
          */
-        interlock<uint32_t, std::variant<GIOPDecoder *, std::exception_ptr>> interlock;
+        RequestTable<std::variant<std::shared_ptr<GIOPDecoder>, std::exception_ptr>> outstanding;
 
         /**
          * counter to create new outgoing request ids
          */
         std::atomic_uint32_t requestId = 0;
 
+        TimerWheel *wheel = nullptr;
+
+        struct Fragmented {
+                /**
+                 * the first message and the fragments' payload received so far
+                 */
+                CDRStreamDecoder message;
+                /**
+                 * see stream()
+                 */
+                std::function<void(CDRStreamDecoder &, bool)> stream;
+                /**
+                 * called instead of returning the reassembled message
+                 */
+                std::function<void(std::exception_ptr)> streamed;
+                /**
+                 * thrown by stream, the remaining fragments are dropped
+                 */
+                std::exception_ptr error;
+        };
+        /**
+         * GIOP 1.2 messages whose fragments are still arriving, by request id
+         */
+        std::map<uint32_t, Fragmented> fragmented;
+        /**
+         * bytes held for the messages in fragmented
+         */
+        size_t fragmentedBytes() const;
+        /**
+         * collect the first message (fragment = false) or a FRAGMENT message of
+         * a fragmented GIOP 1.2 message
+         *
+         * \return the reassembled message once the last fragment arrived,
+         *         nothing when the message is streamed
+         */
+        std::unique_ptr<Buffer> reassemble(uint32_t requestId, bool fragment, bool moreFragments, const char *data, size_t size);
+        /**
+         * pass the fragmented message to handler, starting at offset, while
+         * it's fragments arrive. the last call has last = true. the fragments
+         * are freed once handler has read them and instead of reassembling
+         * the message streamed is called, with the exception thrown by handler
+         * if it failed.
+         */
+        void stream(uint32_t requestId, size_t offset, std::function<void(CDRStreamDecoder &, bool last)> &&handler,
+                    std::function<void(std::exception_ptr)> &&streamed);
+        void pass(uint32_t requestId, Fragmented &entry, bool last);
+        /**
+         * a GIOP CloseConnection message
+         */
+        std::unique_ptr<Buffer> closeConnection();
+
     public:
         Protocol *protocol = nullptr;
         HostAndPort remote;
+        /**
+         * the worker loop owning the connection or nullptr when the connection
+         * belongs to the protocol's loop
+         *
+         * the connection's I/O, outstanding requests and coroutine resumption happen on
+         * the owning loop's thread only, calls made on other threads are posted to it
+         * and resumed on their own loop
+         */
+        std::shared_ptr<EventLoop> owner;
 
-        Connection(Protocol *protocol, const char *host, uint16_t port) : protocol(protocol), remote(HostAndPort{host, port}) {}
+        Connection(Protocol *protocol, const char *host, uint16_t port) : protocol(protocol), remote(HostAndPort{host, port}) {
+            idleTimer.callback = [this] { checkIdle(); };
+        }
         virtual ~Connection();
 
+        /**
+         * the libev loop the connection's watchers are started on
+         */
+        struct ev_loop *loop() const;
+        /**
+         * true when called from the thread of the loop owning the connection
+         */
+        bool isOwnerThread() const;
+        /**
+         * run task on the thread of the loop owning the connection, right away
+         * when already called from there
+         */
+        void post(std::function<void()> &&task);
+        /**
+         * the timer wheel of the loop owning the connection
+         */
+        TimerWheel &timers();
+
         ConnectionState state = ConnectionState::IDLE;
+        /**
+         * opened by ORB::getConnection() as opposed to accepted from a peer
+         */
+        bool outgoing = false;
+        /**
+         * carries the bulk calls to the peer, see ORB::bulkThreshold
+         */
+        bool bulk = false;
+
+        /**
+         * number of twoway calls waiting for a reply
+         */
+        size_t outstandingCalls() const { return outstanding.size(); }
+        /**
+         * number of incoming requests handed to a servant which has not
+         * finished yet
+         */
+        std::atomic_size_t pendingRequests = 0;
+        /**
+         * waiting for a reply or still serving a request, which keeps the
+         * connection from being closed by the ConnectionPool
+         */
+        bool inUse() const { return outstandingCalls() != 0 || pendingRequests.load() != 0; }
+
+        /**
+         * when a message was send or received last, used for the idle timeout
+         * and to find the least recently used connection
+         */
+        std::atomic<std::chrono::steady_clock::time_point> lastActivity = std::chrono::steady_clock::now();
+        /**
+         * set once the connection has been closed, cleared when it is used again
+         */
+        std::atomic_bool closed = false;
+        inline void touch() {
+            lastActivity = std::chrono::steady_clock::now();
+            if (closed.exchange(false)) {
+                startIdleTimer();
+            }
+        }
+        /**
+         * tell the peer with a GIOP CloseConnection message that no further
+         * requests will be send and close the connection. outstanding calls
+         * fail with CORBA::TRANSIENT and the next message reopens it.
+         *
+         * the default implementation only sends the CloseConnection message
+         */
+        virtual void close();
 
         // stubs remove themselves from this list
         std::map<blob, std::shared_ptr<Stub>> stubsById;
 
+        /**
+         * send buffers are drawn from here by GIOPEncoder and returned after they have been written
+         */
+        BufferPool bufferPool;
+
         std::mutex send_mutex;
         // bi-directional service context needs only to be send once
         bool didSendBiDirIIOP = false;
 
+        /**
+         * change the remote address, e.g. when the peer announces it's
+         * listening address via BiDir IIOP
+         */
+        void setRemote(std::string_view host, uint16_t port);
+
         std::string str() const;
+        /**
+         * copy buffer and the segments into a single buffer
+         */
+        std::unique_ptr<Buffer> flatten(std::unique_ptr<Buffer> &&buffer, std::vector<BufferSegment> &&segments);
         virtual void up() = 0;
-        virtual void send(std::unique_ptr<std::vector<char>> &&) = 0;
+        /**
+         * memory currently allocated for receiving data
+         */
+        virtual size_t receiveBufferBytes() const { return 0; }
+        virtual void send(std::unique_ptr<Buffer> &&) = 0;
+        /**
+         * send a message consisting of buffer with segments spliced in
+         *
+         * the default implementation copies the segments into the buffer
+         */
+        virtual void sendv(std::unique_ptr<Buffer> &&buffer, std::vector<BufferSegment> &&segments);
+        /**
+         * copy the caller owned memory referenced by the segments of queued
+         * messages, e.g. before a caller stops waiting for it's reply
+         *
+         * the default implementation does nothing as sendv() copies right away
+         */
+        virtual void releaseSegments() {}
 };
 
 // FIXME: actually, we do not need the temporary ports and ip's:
@@ -84,17 +265,99 @@ class Connection {
 // * if it's a client, it should also listen
 // * if it's a client and it can not listen because of NAT, the client's host:port is send via IIOP
 class ConnectionPool {
-        // FIXME: this needs to be a map, set
-        // std::set<shared_ptr<Connection>, decltype(cmp)> connections;
-        std::set<std::shared_ptr<Connection>> connections;
+        friend class Connection;
+
+        /**
+         * host and port as used by the lookups, which avoids creating a std::string
+         */
+        using Endpoint = std::pair<std::string_view, uint16_t>;
+        static Endpoint endpoint(const HostAndPort &e) { return {e.host, e.port}; }
+        static Endpoint endpoint(const Endpoint &e) { return e; }
+        struct EndpointHash {
+                using is_transparent = void;
+                size_t operator()(const auto &e) const {
+                    auto [host, port] = endpoint(e);
+                    return std::hash<std::string_view>{}(host) * 31 + port;
+                }
+        };
+        struct EndpointEqual {
+                using is_transparent = void;
+                bool operator()(const auto &a, const auto &b) const { return endpoint(a) == endpoint(b); }
+        };
+        using Index = std::unordered_map<HostAndPort, std::unordered_set<Connection *>, EndpointHash, EndpointEqual>;
+
+        struct Entry {
+                std::shared_ptr<Connection> connection;
+                /**
+                 * the protocol's local address at the time of insert(), the key in byLocal
+                 */
+                HostAndPort local;
+        };
+        std::unordered_map<Connection *, Entry> connections;
+        Index byRemote;
+        Index byLocal;
+        // connections are accepted on worker loops
+        mutable std::mutex mutex;
+        size_t evicted = 0;
+
+        static void add(Index &index, const HostAndPort &key, Connection *connection);
+        static void remove(Index &index, const HostAndPort &key, Connection *connection);
+        static std::shared_ptr<Connection> find(const Index &index, const char *host, uint16_t port);
+        void erase(std::unordered_map<Connection *, Entry>::iterator entry);
+        std::shared_ptr<Connection> release(Connection *connection);
+        void evict(Connection *connection);
+        /**
+         * change the remote address of connection, e.g. for BiDir IIOP
+         */
+        void setRemote(Connection *connection, std::string_view host, uint16_t port);
 
     public:
-        inline void insert(std::shared_ptr<Connection> conn) { connections.insert(conn); }
-        inline void erase(std::shared_ptr<Connection> conn) { connections.erase(conn); }
-        inline void clear() { connections.clear(); }
-        inline size_t size() const { return connections.size(); }
+        /**
+         * close connections which have neither send nor received a message for
+         * this long, 0 to keep them open
+         */
+        std::chrono::milliseconds idleTimeout{0};
+        /**
+         * when inserting more than this many open connections, close the least
+         * recently used idle connection, 0 for no limit
+         */
+        size_t maxConnections = 0;
+
+        struct Stats {
+                /**
+                 * connections which have not been closed
+                 */
+                size_t open = 0;
+                /**
+                 * open connections neither waiting for a reply nor serving a request
+                 */
+                size_t idle = 0;
+                /**
+                 * open connections waiting for a reply or serving a request
+                 */
+                size_t inUse = 0;
+                /**
+                 * connections closed by the idle timeout or maxConnections
+                 */
+                size_t evicted = 0;
+        };
+
+        void insert(std::shared_ptr<Connection> conn);
+        void erase(std::shared_ptr<Connection> conn);
+        /**
+         * close connection and drop it from the pool unless it is still used
+         * by a stub
+         */
+        void close(Connection *connection);
+        void clear();
+        inline size_t size() const {
+            std::lock_guard lock(mutex);
+            return connections.size();
+        }
+        Stats stats() const;
         std::shared_ptr<Connection> findByLocal(const char *host, uint16_t port) const;
         std::shared_ptr<Connection> findByRemote(const char *host, uint16_t port) const;
+        std::vector<std::shared_ptr<Connection>> findAllByRemote(const char *host, uint16_t port) const;
         void print() const;
 };
 
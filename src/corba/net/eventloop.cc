@@ -0,0 +1,85 @@
+#include "eventloop.hh"
+#include "timerwheel.hh"
+
+#include <cstddef>
+
+namespace CORBA {
+
+namespace detail {
+
+static thread_local EventLoop *currentLoop = nullptr;
+
+EventLoop::EventLoop(struct ev_loop *loop) : loop(loop), home(nullptr) {
+    ev_async_init(&wakeup, libev_async_cb);
+    ev_async_start(loop, &wakeup);
+    // the watcher is not supposed to keep the application's ev_run() alive
+    ev_unref(loop);
+}
+
+EventLoop::EventLoop(EventLoop *home) : loop(ev_loop_new(EVFLAG_AUTO)), home(home) {
+    ev_async_init(&wakeup, libev_async_cb);
+    ev_async_start(loop, &wakeup);
+}
+
+EventLoop::~EventLoop() {
+    if (home) {
+        stop();
+        ev_async_stop(loop, &wakeup);
+        TimerWheel::release(loop);
+        ev_loop_destroy(loop);
+    } else {
+        ev_ref(loop);
+        ev_async_stop(loop, &wakeup);
+    }
+}
+
+void EventLoop::post(std::function<void()> &&task) {
+    {
+        std::lock_guard lock(mutex);
+        tasks.push_back(std::move(task));
+    }
+    ev_async_send(loop, &wakeup);
+}
+
+void EventLoop::start() {
+    if (home && !running) {
+        running = true;
+        thread = std::thread([this] { run(); });
+    }
+}
+
+void EventLoop::stop() {
+    if (!running) {
+        return;
+    }
+    post([this] { ev_break(loop, EVBREAK_ALL); });
+    thread.join();
+    running = false;
+    std::lock_guard lock(mutex);
+    tasks.clear();
+}
+
+void EventLoop::run() {
+    currentLoop = this;
+    ev_run(loop, 0);
+    currentLoop = nullptr;
+}
+
+bool EventLoop::isCurrent() const { return home ? currentLoop == this : currentLoop == nullptr; }
+
+EventLoop *EventLoop::current() { return currentLoop; }
+
+void EventLoop::libev_async_cb(struct ev_loop *loop, struct ev_async *watcher, int revents) {
+    auto self = reinterpret_cast<EventLoop *>(reinterpret_cast<char *>(watcher) - offsetof(EventLoop, wakeup));
+    std::vector<std::function<void()>> pending;
+    {
+        std::lock_guard lock(self->mutex);
+        pending.swap(self->tasks);
+    }
+    for (auto &task : pending) {
+        task();
+    }
+}
+
+}  // namespace detail
+}  // namespace CORBA
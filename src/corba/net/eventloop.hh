@@ -0,0 +1,74 @@
+#pragma once
+
+#include <ev.h>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace CORBA {
+
+namespace detail {
+
+/**
+ * A libev loop to which other threads can hand work.
+ *
+ * EventLoop(loop) wraps the loop run by the application (the home loop) and
+ * EventLoop(home) creates a worker loop which runs on a thread of it's own.
+ *
+ * post() may be called from any thread, the task is then run on the loop's
+ * thread.
+ */
+class EventLoop : public std::enable_shared_from_this<EventLoop> {
+        ev_async wakeup;
+        std::mutex mutex;
+        std::vector<std::function<void()>> tasks;
+        std::thread thread;
+        bool running = false;
+
+        static void libev_async_cb(struct ev_loop *loop, struct ev_async *watcher, int revents);
+        void run();
+
+    public:
+        struct ev_loop *const loop;
+        /**
+         * the loop run by the application, nullptr for the home loop itself
+         */
+        EventLoop *const home;
+        /**
+         * number of connections owned by this loop
+         */
+        std::atomic_size_t connections = 0;
+
+        EventLoop(struct ev_loop *loop);
+        EventLoop(EventLoop *home);
+        ~EventLoop();
+
+        /**
+         * run task on the loop's thread
+         */
+        void post(std::function<void()> &&task);
+        /**
+         * start the thread of a worker loop
+         */
+        void start();
+        /**
+         * stop and join the thread of a worker loop, tasks which have not been
+         * run yet are dropped
+         */
+        void stop();
+        /**
+         * true when called from the loop's thread
+         */
+        bool isCurrent() const;
+        /**
+         * the worker loop running on the calling thread or nullptr
+         */
+        static EventLoop *current();
+};
+
+}  // namespace detail
+}  // namespace CORBA
@@ -0,0 +1,83 @@
+#include "sendqueue.hh"
+
+namespace CORBA {
+
+namespace detail {
+
+void SendQueue::push(std::unique_ptr<Buffer> &&buffer, std::vector<BufferSegment> &&segments) {
+    if (count == ring.size()) {
+        // grow to the next power of two and move the messages to the beginning
+        std::vector<OutgoingMessage> larger(ring.empty() ? 8 : ring.size() * 2);
+        for (size_t i = 0; i < count; ++i) {
+            larger[i] = std::move((*this)[i]);
+        }
+        ring.swap(larger);
+        head = 0;
+    }
+    auto &message = ring[(head + count) & (ring.size() - 1)];
+    message.size = buffer->size();
+    for (auto &segment : segments) {
+        message.size += segment.size;
+    }
+    message.buffer = std::move(buffer);
+    message.segments = std::move(segments);
+    ++count;
+}
+
+size_t SendQueue::gather(struct iovec *iov, size_t iovmax, size_t *nbytes) {
+    size_t iovcnt = 0;
+    size_t total = 0;
+    size_t skip = sent;
+    auto add = [&](const char *data, size_t size) {
+        if (skip >= size) {
+            skip -= size;
+            return;
+        }
+        if (iovcnt < iovmax) {
+            iov[iovcnt].iov_base = const_cast<char *>(data + skip);
+            iov[iovcnt].iov_len = size - skip;
+            total += size - skip;
+            ++iovcnt;
+        }
+        skip = 0;
+    };
+    for (size_t i = 0; i < count && iovcnt < iovmax; ++i) {
+        auto &message = (*this)[i];
+        auto data = message.buffer->data();
+        size_t position = 0;
+        for (auto &segment : message.segments) {
+            add(data + position, segment.position - position);
+            add(segment.data, segment.size);
+            position = segment.position;
+        }
+        add(data + position, message.buffer->size() - position);
+    }
+    if (nbytes) {
+        *nbytes = total;
+    }
+    return iovcnt;
+}
+
+void SendQueue::consume(size_t nbytes, BufferPool &pool) {
+    sent += nbytes;
+    while (count > 0 && sent >= front().size) {
+        auto &message = front();
+        sent -= message.size;
+        pool.release(std::move(message.buffer));
+        message.segments.clear();
+        head = (head + 1) & (ring.size() - 1);
+        --count;
+    }
+}
+
+void SendQueue::clear() {
+    for (size_t i = 0; i < count; ++i) {
+        auto &message = (*this)[i];
+        message.buffer.reset();
+        message.segments.clear();
+    }
+    head = count = sent = 0;
+}
+
+}  // namespace detail
+}  // namespace CORBA
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <sys/uio.h>
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "../util/bufferpool.hh"
+
+namespace CORBA {
+
+namespace detail {
+
+/**
+ * an encoded message waiting to be written
+ */
+struct OutgoingMessage {
+        std::unique_ptr<Buffer> buffer;
+        /**
+         * caller owned memory spliced into buffer
+         */
+        std::vector<BufferSegment> segments;
+        /**
+         * buffer's size plus the segment's sizes
+         */
+        size_t size = 0;
+};
+
+/**
+ * The messages queued for writing to a socket.
+ *
+ * The messages are kept in a ring which only grows, so that queuing a message
+ * does not allocate once the connection has warmed up. gather() describes all
+ * pending bytes as an iovec array so that the connection can write them with a
+ * single sendmsg(), consume() then drops what has been written, which may end
+ * in the middle of a message or segment.
+ */
+class SendQueue {
+        std::vector<OutgoingMessage> ring;
+        size_t head = 0;
+        size_t count = 0;
+        /**
+         * bytes of the first message which have already been written
+         */
+        size_t sent = 0;
+
+    public:
+        void push(std::unique_ptr<Buffer> &&buffer, std::vector<BufferSegment> &&segments);
+
+        inline bool empty() const { return count == 0; }
+        inline size_t size() const { return count; }
+        inline OutgoingMessage &operator[](size_t index) { return ring[(head + index) & (ring.size() - 1)]; }
+        inline OutgoingMessage &front() { return ring[head]; }
+        /**
+         * bytes of the first message which have already been written
+         */
+        inline size_t offset() const { return sent; }
+
+        /**
+         * fill iov with at most iovmax entries describing the bytes not yet written
+         *
+         * \return the number of entries in iov
+         */
+        size_t gather(struct iovec *iov, size_t iovmax, size_t *nbytes = nullptr);
+        /**
+         * remove nbytes from the front of the queue and give the buffers of
+         * completely written messages back to pool
+         */
+        void consume(size_t nbytes, BufferPool &pool);
+        void clear();
+};
+
+}  // namespace detail
+}  // namespace CORBA
@@ -1,6 +1,8 @@
 #include "stream2packet.hh"
 
+#include <cstring>
 #include <print>
+#include <utility>
 
 #include "../giop.hh"
 
@@ -12,53 +14,157 @@ namespace detail {
 
 #define DBG(CMD)
 
-char *IIOPStream2Packet::buffer() {
-    DBG(println("IIOPStream2Packet::buffer()");)
+static constexpr size_t GIOP_HEADER_SIZE = 12;
+
+void IIOPStream2Packet::prepare() {
     DBG(println("    enter                     : offset={}, size={}, reserved={}, messageSize={}", offset, size, reserved, messageSize);)
-    if (reserved - size < receiveBufferSize) {
-        reserved += receiveBufferSize;
-        data = (char *)realloc(data, reserved);
-        DBG(println("    reserved additional memory: offset={}, size={}, reserved={}, messageSize={}", offset, size, reserved, messageSize);)
+    if (offset == size) {
+        offset = size = 0;
+        // shrink after a large message and leave a buffer behind which still holds a message in use
+        if (reserved > receiveBufferSize || storage.use_count() > 1) {
+            storage.reset();
+            data = nullptr;
+            reserved = 0;
+        }
     }
+    if (spareSize == 0 && (spareReserved > receiveBufferSize || spareStorage.use_count() > 1)) {
+        spareStorage.reset();
+        spare = nullptr;
+        spareReserved = 0;
+    }
+    if (data == nullptr) {
+        reserved = receiveBufferSize;
+        storage = make_shared_for_overwrite<char[]>(reserved);
+        data = storage.get();
+    }
+    if (messageSize != 0) {
+        if (offset + messageSize > reserved) {
+            // grow to the announced size in one step, only what has been received so far is copied
+            relocate(max(messageSize, receiveBufferSize));
+            DBG(println("    grow to message size      : offset={}, size={}, reserved={}, messageSize={}", offset, size, reserved, messageSize);)
+        }
+    } else if (offset > 0 && reserved - size < receiveBufferSize / 2) {
+        // less than a GIOP header is pending at the end of the buffer
+        if (storage.use_count() > 1) {
+            relocate(receiveBufferSize);
+        } else {
+            memmove(data, data + offset, size - offset);
+            size -= offset;
+            offset = 0;
+        }
+    }
+}
+
+void IIOPStream2Packet::relocate(size_t capacity) {
+    auto buffer = make_shared_for_overwrite<char[]>(capacity);
+    memcpy(buffer.get(), data + offset, size - offset);
+    storage = move(buffer);
+    data = storage.get();
+    reserved = capacity;
+    size -= offset;
+    offset = 0;
+}
+
+void IIOPStream2Packet::clear() {
+    storage.reset();
+    spareStorage.reset();
+    data = spare = nullptr;
+    last = nullptr;
+    size = reserved = offset = messageSize = 0;
+    spareSize = spareReserved = limit = 0;
+}
+
+char *IIOPStream2Packet::buffer() {
+    DBG(println("IIOPStream2Packet::buffer()");)
+    prepare();
+    limit = 0;
     return data + size;
 }
 
+int IIOPStream2Packet::buffers(struct iovec *iov) {
+    DBG(println("IIOPStream2Packet::buffers()");)
+    prepare();
+    iov[0].iov_base = data + size;
+    iov[0].iov_len = reserved - size;
+    if (messageSize == 0) {
+        limit = 0;
+        return 1;
+    }
+    // the rest of the pending message goes into the current buffer, what follows into the spare one
+    limit = offset + messageSize - size;
+    iov[0].iov_len = limit;
+    if (spare == nullptr) {
+        spareReserved = receiveBufferSize;
+        spareStorage = make_shared_for_overwrite<char[]>(spareReserved);
+        spare = spareStorage.get();
+    }
+    iov[1].iov_base = spare;
+    iov[1].iov_len = spareReserved;
+    return 2;
+}
+
+void IIOPStream2Packet::received(size_t nbytes) {
+    DBG(println("IIOPStream2Packet::received({})", nbytes);)
+    if (limit != 0 && nbytes > limit) {
+        size += limit;
+        spareSize = nbytes - limit;
+    } else {
+        size += nbytes;
+    }
+    limit = 0;
+    DBG(println("    received more data        : offset={}, size={}, reserved={}, messageSize={}", offset, size, reserved, messageSize);)
+}
+
+void IIOPStream2Packet::swap() {
+    std::swap(storage, spareStorage);
+    std::swap(data, spare);
+    std::swap(reserved, spareReserved);
+    size = spareSize;
+    offset = 0;
+    spareSize = 0;
+}
+
 std::span<char> IIOPStream2Packet::message() {
     DBG(println("IIOPStream2Packet::message()");)
     DBG(println("    get message               : offset={}, size={}, reserved={}, messageSize={}", offset, size, reserved, messageSize);)
+    if (offset == size && spareSize != 0) {
+        swap();
+    }
     if (messageSize == 0 && size - offset >= 16) {
         CORBA::CDRDecoder cdr(data + offset, size - offset);
         CORBA::GIOPDecoder giop(cdr);
         giop.scanGIOPHeader();
-        messageSize = giop.m_length + 12;
+        messageSize = giop.m_length + GIOP_HEADER_SIZE;
         DBG(println("    got message size          : offset={}, size={}, reserved={}, messageSize={}", offset, size, reserved, messageSize);)
     }
-    if (messageSize == 0) {
+    if (messageSize == 0 || size - offset < messageSize) {
+        // incomplete message, buffer()/buffers() will make room for the rest
         DBG(println("    no more messages          : offset={}, size={}, reserved={}, messageSize={}", offset, size, reserved, messageSize);)
         return {};
     }
-    if (messageSize != 0 && size - offset < messageSize) {
-        // incomplete message at buffer end, move to front of buffer
-        DBG(println("    no more messages, move    : offset={}, size={}, reserved={}, messageSize={}", offset, size, reserved, messageSize);)
-        if (offset > 0) {
-            DBG(println("      move(0, {}, {})", offset, size - offset);)
-            memmove(data, data + offset, size - offset);
-        }
-        size -= offset;
-        offset = 0;
-        DBG(println("    moved                     : offset={}, size={}, reserved={}, messageSize={}", offset, size, reserved, messageSize);)
-        return {};
-    }
     span result(data + offset, data + offset + messageSize);
+    last = result.data();
     offset += messageSize;
     messageSize = 0;
-    if (offset == size) {
-        offset = size = 0;
-        DBG(println("    offset reached end, reset : offset={}, size={}, reserved={}, messageSize={}", offset, size, reserved, messageSize);)
+    // the data is kept until the next call to buffer()/buffers(), hence
+    // result stays valid when switching to the spare buffer
+    if (offset == size && spareSize != 0) {
+        swap();
     }
     DBG(println("    return message            : offset={}, size={}, reserved={}, messageSize={}", offset, size, reserved, messageSize);)
     return result;
 }
 
+std::shared_ptr<const void> IIOPStream2Packet::owner() const {
+    // message() might have switched to the spare buffer after returning the message
+    if (last >= data && last < data + reserved) {
+        return storage;
+    }
+    if (last >= spare && last < spare + spareReserved) {
+        return spareStorage;
+    }
+    return {};
+}
+
 }  // namespace detail
 }  // namespace CORBA
@@ -1,6 +1,9 @@
 #pragma once
 
+#include <sys/uio.h>
+
 #include <cstdlib>
+#include <memory>
 #include <span>
 
 namespace CORBA {
@@ -12,10 +15,22 @@ namespace detail {
 
 /**
  * Am internal helper class to convert a byte stream into CORBA IIOP packets.
+ *
+ * The receive buffer starts with receiveBufferSize bytes. Once the GIOP header
+ * of a message announces a larger size, the buffer grows to that size in one
+ * step and shrinks back once the message has been consumed.
+ *
+ * For readv(), buffers() provides the rest of the message currently being
+ * received plus a spare buffer for the data following it, so that messages
+ * always end up in one piece without moving them to the front of the buffer.
+ *
+ * The buffers are reference counted. A message stays valid for as long as
+ * someone holds on to owner(), buffers still referenced that way are left
+ * behind instead of being reused.
  */
 class IIOPStream2Packet {
     public:
-        size_t receiveBufferSize = 0x20000;
+        size_t receiveBufferSize = 0x2000;
         char *data = nullptr;
         size_t size = 0;
         size_t reserved = 0;
@@ -23,8 +38,7 @@ class IIOPStream2Packet {
         size_t offset = 0;
         size_t messageSize = 0;
 
-        IIOPStream2Packet(size_t receiveBufferSize = 0x20000) : receiveBufferSize(receiveBufferSize) {}
-        ~IIOPStream2Packet() { free(data); }
+        IIOPStream2Packet(size_t receiveBufferSize = 0x2000) : receiveBufferSize(receiveBufferSize) {}
 
         /**
          * get buffer for next read operation
@@ -37,17 +51,58 @@ class IIOPStream2Packet {
         inline size_t length() { return reserved - size; }
 
         /**
-         * inform about how many bytes have been read into buffer
+         * get one or two buffers for the next readv()
+         *
+         * \param iov array of at least two entries
+         * \return number of entries filled in
          */
-        inline void received(size_t nbytes) {
-            DBG(println("IIOPStream2Packet::received({})", nbytes);)
-            size += nbytes;
-            DBG(println("    received more data        : offset={}, size={}, reserved={}, messageSize={}", offset, size, reserved, messageSize);)
-        }
+        int buffers(struct iovec *iov);
+
+        /**
+         * inform about how many bytes have been read into buffer() or buffers()
+         */
+        void received(size_t nbytes);
+
         /**
          * return one CORBA IIOP packet or an empty span
          */
         std::span<char> message();
+
+        /**
+         * the buffer holding the message last returned by message(), it keeps
+         * the message valid after the next call to buffer()/buffers()
+         */
+        std::shared_ptr<const void> owner() const;
+
+        /**
+         * memory allocated for receiving
+         */
+        inline size_t bufferBytes() const { return reserved + spareReserved; }
+
+        /**
+         * drop what has been received so far and free the buffers, e.g. after
+         * the connection has been closed
+         */
+        void clear();
+
+    protected:
+        std::shared_ptr<char[]> storage;
+        // buffer following data, filled by the 2nd iovec of buffers()
+        std::shared_ptr<char[]> spareStorage;
+        char *spare = nullptr;
+        size_t spareSize = 0;
+        size_t spareReserved = 0;
+        // length of the 1st iovec when buffers() returned two
+        size_t limit = 0;
+        // start of the message last returned by message()
+        const char *last = nullptr;
+
+        void prepare();
+        /**
+         * move the pending data to the front of a new buffer of capacity bytes
+         */
+        void relocate(size_t capacity);
+        void swap();
 };
 
 #undef DGB
@@ -5,6 +5,11 @@
 
 #include <unistd.h>
 #include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <bit>
+#include <climits>
+#include <cstring>
 #include <print>
 
 using namespace std;
@@ -20,23 +25,97 @@ static string prefix(TcpConnection *conn) {
     return result;
 }
 
-void TcpConnection::send(unique_ptr<vector<char>> &&buffer) {
-    Logger::debug("{}TcpConnection::send(): {} bytes", prefix(this), buffer->size());
-    sendBuffer.push_back(move(buffer));
+void TcpConnection::send(unique_ptr<Buffer> &&buffer) { sendv(move(buffer), {}); }
+
+void TcpConnection::sendv(unique_ptr<Buffer> &&buffer, vector<BufferSegment> &&segments) {
+    if (!isOwnerThread()) {
+        // e.g. the reply of a servant which is not loop-local
+        auto message = make_shared<OutgoingMessage>(move(buffer), move(segments), 0);
+        post([self = shared_from_this(), message] { self->sendv(move(message->buffer), move(message->segments)); });
+        return;
+    }
+    Logger::debug("{}TcpConnection::send(): {} bytes in {} segments", prefix(this), buffer->size(), segments.size());
+    bool idle = sendBuffer.empty() && unfragmented.empty();
+    size_t size = buffer->size();
+    for (auto &segment : segments) {
+        size += segment.size;
+    }
+    // only GIOP 1.2 requests and replies carry the request id needed for fragments
+    auto data = buffer->data();
+    if (fragmentSize != 0 && size > fragmentSize && data[4] == 1 && data[5] >= 2 &&
+        (data[7] == static_cast<char>(MessageType::REQUEST) || data[7] == static_cast<char>(MessageType::REPLY))) {
+        unfragmented.push_back({move(buffer), move(segments), size});
+    } else {
+        sendBuffer.push(move(buffer), move(segments));
+    }
     switch (state) {
         case ConnectionState::IDLE:
             up();
             break;
         case ConnectionState::ESTABLISHED:
-            startWriteHandler();
+            // when messages are already queued, the write watcher is armed anyway
+            if (eagerWrite && idle) {
+                canWrite(true);
+            } else {
+                startWriteHandler();
+            }
             break;
     }
 }
 
-void TcpConnection::recv(void *buffer, size_t nbytes) {
+void TcpConnection::close() {
+    if (!isOwnerThread()) {
+        post([self = shared_from_this()] { self->close(); });
+        return;
+    }
+    if (fd == -1) {
+        closed = true;
+        return;
+    }
+    if (state != ConnectionState::ESTABLISHED) {
+        disconnect(make_exception_ptr(TRANSIENT(0, CORBA::CompletionStatus::NO)));
+        return;
+    }
+    Logger::debug("{}TcpConnection::close()", prefix(this));
+    // canWrite() disconnects once the send buffer is empty
+    lingering = shared_from_this();
+    closed = true;
+    // the peer drops a message whose fragments arrive after CloseConnection
+    closing = true;
+    canWrite();
+}
+
+/**
+ * close the socket and free the receive buffer, the connection is reopened
+ * by the next message send
+ */
+void TcpConnection::disconnect(exception_ptr reason) {
+    // the connection might have only been kept alive by lingering
+    auto self = move(lingering);
+    stopTimer();
+    stopWriteHandler();
+    stopReadHandler();
+    ::close(fd);
+    fd = -1;
+    state = ConnectionState::IDLE;
+    closed = true;
+    closing = false;
+    releaseSegments();
+    // the rest of a fragmented message can not be send over another connection
+    for (auto &message : unfragmented) {
+        bufferPool.release(move(message.buffer));
+    }
+    unfragmented.clear();
+    fragmentOffset = 0;
+    fragmented.clear();
+    stream2packet.clear();
+    outstanding.resumeAll(reason);
+}
+
+void TcpConnection::recv(void *buffer, size_t nbytes, std::shared_ptr<const void> holder) {
     Logger::debug("{}TcpConnection::recv(): {} bytes", prefix(this), nbytes);
     if (protocol && protocol->orb) {
-        protocol->orb->socketRcvd(this, buffer, nbytes);
+        protocol->orb->socketRcvd(this, buffer, nbytes, move(holder));
     }
     if (receiver) {
         receiver(buffer, nbytes);
@@ -68,7 +147,7 @@ TcpConnection::~TcpConnection() {
     }
 }
 
-void TcpConnection::canWrite() {
+void TcpConnection::canWrite(bool eager) {
     Logger::debug("{}TcpConnection::canWrite(): sendbuffer size = {}, fd = {}", prefix(this), sendBuffer.size(), fd);
     stopWriteHandler();
 
@@ -90,7 +169,7 @@ void TcpConnection::canWrite() {
             }
             // TODO: when bidirectional or there are packets to be send, go to PENDING instead of IDLE
             state = ConnectionState::IDLE;
-            close(fd);
+            ::close(fd);
             fd = -1;
             return;
         } else {
@@ -101,22 +180,33 @@ void TcpConnection::canWrite() {
         }
     }
 
-    while (!sendBuffer.empty()) {
-        auto data = sendBuffer.front()->data();
-        auto nbytes = sendBuffer.front()->size();
+    // all queued messages are written with a single sendmsg(), the loop only
+    // repeats when there were more than IOV_MAX buffers and segments
+    while (!sendBuffer.empty() || nextFragment() || queueCloseConnection()) {
+        struct iovec iov[IOV_MAX];
+        size_t nbytes;
+        struct msghdr msg = {};
+        msg.msg_iov = iov;
+        msg.msg_iovlen = sendBuffer.gather(iov, IOV_MAX, &nbytes);
 
-        ssize_t n = ::send(fd, data + bytesSend, nbytes - bytesSend, 0);
+        ssize_t n = ::sendmsg(fd, &msg, 0);
 
         if (n >= 0) {
-            Logger::debug("{}TcpConnection::canWrite(): sendbuffer size {}: send {} bytes at {} of out {}", prefix(this), sendBuffer.size(), n, bytesSend,
-                    nbytes - bytesSend);
+            Logger::debug("{}TcpConnection::canWrite(): sendbuffer size {}: send {} bytes at {} of out {}", prefix(this), sendBuffer.size(), n,
+                          sendBuffer.offset(), nbytes);
         } else {
             if (errno == EPIPE) {
+                if (eager) {
+                    // the twoway call which queued the message is not yet
+                    // registered in outstanding, let the write watcher fail
+                    // it once it awaits the reply
+                    Logger::debug("{}TcpConnection::canWrite(): broken connection, defer to write handler", prefix(this));
+                    startWriteHandler();
+                    return;
+                }
                 Logger::debug("{}TcpConnection::canWrite(): broken connection -> IDLE", prefix(this));
                 // TODO: when bidirectional or there are packets to be send, go to PENDING instead of IDLE
-                state = ConnectionState::IDLE;
-                close(fd);
-                fd = -1;
+                disconnect(make_exception_ptr(TRANSIENT(0, CORBA::CompletionStatus::NO)));
                 return;
             } else if (errno != EAGAIN) {
                 Logger::debug("{}TcpConnection::canWrite(): sendbuffer size {}: error: {} ({})", prefix(this), sendBuffer.size(), strerror(errno), errno);
@@ -126,13 +216,9 @@ void TcpConnection::canWrite() {
             break;
         }
 
-        if (n != nbytes - bytesSend) {
-            // Logger::debug("************************************************** incomplete send");
-            bytesSend += n;
+        sendBuffer.consume(n, bufferPool);
+        if (static_cast<size_t>(n) != nbytes) {
             break;
-        } else {
-            sendBuffer.pop_front();
-            bytesSend = 0;
         }
     }
 
@@ -141,48 +227,165 @@ void TcpConnection::canWrite() {
         startWriteHandler();
     } else {
         Logger::debug("{}TcpConnection::canWrite(): sendbuffer size {}: nothing more to send", prefix(this), sendBuffer.size());
+        if (lingering) {
+            disconnect(make_exception_ptr(TRANSIENT(0, CORBA::CompletionStatus::NO)));
+        }
+    }
+}
+
+/**
+ * Queue the next fragment of the first message in unfragmented.
+ *
+ * All fragments but the last are a multiple of 8 bytes long, which keeps the
+ * CDR alignment of the data. The bytes of the message's buffer are copied into
+ * the fragment while the segments are only referenced.
+ */
+bool TcpConnection::nextFragment() {
+    if (unfragmented.empty()) {
+        return false;
+    }
+    auto &message = unfragmented.front();
+    auto data = message.buffer->data();
+    bool first = fragmentOffset == 0;
+    size_t headerSize = first ? 0 : 16;
+    size_t payload = min((max(fragmentSize, size_t(64)) & ~size_t(7)) - headerSize, message.size - fragmentOffset);
+    size_t begin = fragmentOffset, end = fragmentOffset + payload;
+    bool more = end < message.size;
+
+    auto buffer = bufferPool.acquire();
+    vector<BufferSegment> segments;
+    if (!first) {
+        // GIOP header and request id of the original message
+        buffer->insert(buffer->end(), data, data + headerSize);
+        (*buffer)[7] = static_cast<char>(MessageType::FRAGMENT);
+    }
+    size_t at = 0;
+    auto add = [&](const char *piece, size_t size, bool segment) {
+        size_t from = max(at, begin), to = min(at + size, end);
+        if (from < to) {
+            if (segment) {
+                segments.push_back({buffer->size(), piece + (from - at), to - from});
+            } else {
+                buffer->insert(buffer->end(), piece + (from - at), piece + (to - at));
+            }
+        }
+        at += size;
+    };
+    size_t position = 0;
+    for (auto &segment : message.segments) {
+        add(data + position, segment.position - position, false);
+        add(segment.data, segment.size, true);
+        position = segment.position;
+    }
+    add(data + position, message.buffer->size() - position, false);
+
+    (*buffer)[6] = (data[6] & 1) | (more ? 2 : 0);
+    uint32_t length = headerSize + payload - 12;
+    if (static_cast<bool>(data[6] & 1) != (std::endian::native == std::endian::little)) {
+        length = byteswap(length);
+    }
+    memcpy(buffer->data() + 8, &length, sizeof(length));
+
+    Logger::debug("{}TcpConnection::nextFragment(): {} bytes at {} of {}", prefix(this), payload, begin, message.size);
+    sendBuffer.push(move(buffer), move(segments));
+    fragmentOffset = end;
+    if (!more) {
+        bufferPool.release(move(message.buffer));
+        unfragmented.pop_front();
+        fragmentOffset = 0;
+    }
+    return true;
+}
+
+/**
+ * Queue the CloseConnection message requested by close() once the send
+ * buffer and the fragments have been written.
+ */
+bool TcpConnection::queueCloseConnection() {
+    if (!closing) {
+        return false;
+    }
+    closing = false;
+    sendBuffer.push(closeConnection(), {});
+    return true;
+}
+
+/**
+ * The memory referenced by segments is only guaranteed to be valid while the
+ * caller awaits the reply. Before failing the callers, copy the segments of
+ * the messages which remain queued.
+ *
+ * The bytes already written and the fragments already queued are counted
+ * within the whole message, hence they stay valid when the segments are
+ * copied into the buffer.
+ */
+void TcpConnection::releaseSegments() {
+    for (size_t i = 0; i < sendBuffer.size(); ++i) {
+        auto &message = sendBuffer[i];
+        if (!message.segments.empty()) {
+            message.buffer = flatten(move(message.buffer), move(message.segments));
+        }
+    }
+    for (auto &message : unfragmented) {
+        if (!message.segments.empty()) {
+            message.buffer = flatten(move(message.buffer), move(message.segments));
+        }
     }
 }
 
 void TcpConnection::canRead() {
     Logger::debug("{}TcpConnection::canRead()", prefix(this));
-    ssize_t nbytes = ::recv(fd, stream2packet.buffer(), stream2packet.length(), 0);
-    if (nbytes < 0) {
-        if (errno == EAGAIN) {
-            Logger::debug("{}TcpConnection::canRead(): {} (EGAIN)", prefix(this), strerror(errno));
+    // a message might make the ORB close the connection and drop the last reference to it
+    auto self = shared_from_this();
+    // read until the socket is drained, but after readBudget bytes return to
+    // the event loop so that other connections get their turn
+    size_t budget = readBudget;
+    while (fd != -1) {
+        struct iovec iov[2];
+        auto iovcnt = stream2packet.buffers(iov);
+        size_t requested = iov[0].iov_len + (iovcnt > 1 ? iov[1].iov_len : 0);
+        ssize_t nbytes = ::readv(fd, iov, iovcnt);
+        if (nbytes < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN) {
+                Logger::debug("{}TcpConnection::canRead(): {} (EGAIN)", prefix(this), strerror(errno));
+                return;
+            }
+            if (errno == EBADF) {
+                Logger::debug("{}TcpConnection::canRead(): failed to connect to peer", prefix(this));
+            } else {
+                Logger::debug("{}TcpConnection::canRead(): {} ({})", prefix(this), strerror(errno), errno);
+            }
+            // TODO: if there packets to be send, switch to pending
+            disconnect(make_exception_ptr(TRANSIENT(0, CORBA::CompletionStatus::NO)));
             return;
         }
-        if (errno == EBADF) {
-            Logger::debug("{}TcpConnection::canRead(): failed to connect to peer", prefix(this));
-        } else {
-            Logger::debug("{}TcpConnection::canRead(): {} ({})", prefix(this), strerror(errno), errno);
+        Logger::debug("{}TcpConnection::canRead(): state = {}", prefix(this), std::to_underlying(state));
+        if (state == ConnectionState::INPROGRESS) {
+            state = ConnectionState::ESTABLISHED;
+            stopTimer();
         }
-        stopReadHandler();
-        ::close(fd);
-        fd = -1;
-        // TODO: if there packets to be send, switch to pending
-        // TODO: have one method to switch the state and perform the needed actions (e.g. handle timers)?
-        state = ConnectionState::IDLE;
-        while(!interlock.empty()) {
-            interlock.resume(interlock.begin()->first, make_exception_ptr(TRANSIENT(0, CORBA::CompletionStatus::NO)));
+        Logger::debug("{}recv'd {} bytes", prefix(this), nbytes);
+        if (nbytes == 0) {
+            Logger::debug("{}TcpConnection::canRead(): closed by peer", prefix(this));
+            disconnect(make_exception_ptr(TRANSIENT(0, CORBA::CompletionStatus::NO)));
+            return;
         }
-        return;
-    }
-    Logger::debug("{}TcpConnection::canRead(): state = {}", prefix(this), std::to_underlying(state));
-    if (state == ConnectionState::INPROGRESS) {
-        state = ConnectionState::ESTABLISHED;
-        stopTimer();
-    }
-    Logger::debug("{}recv'd {} bytes", prefix(this), nbytes);
-    if (nbytes > 0) {
         stream2packet.received(nbytes);
         while(true) {
             auto msg = stream2packet.message();
             if (msg.empty()) {
                 break;
             }
-            recv(msg.data(), msg.size());
+            recv(msg.data(), msg.size(), stream2packet.owner());
+        }
+        // a short read means the socket has been drained, which saves the readv() returning EAGAIN
+        if (static_cast<size_t>(nbytes) < requested || budget <= static_cast<size_t>(nbytes)) {
+            return;
         }
+        budget -= nbytes;
     }
 }
 
@@ -217,6 +420,7 @@ void TcpConnection::up() {
 }
 
 TcpConnection::TcpConnection(Protocol *protocol, const char *host, uint16_t port) : Connection(protocol, host, port) {
+    connectTimer.callback = [this] { timer(); };
 }
 
 void TcpConnection::libev_read_cb(struct ev_loop *loop, struct ev_io *watcher, int revents) {
@@ -229,24 +433,19 @@ void TcpConnection::libev_write_cb(struct ev_loop *loop, struct ev_io *watcher,
     connection->canWrite();
 }
 
-void TcpConnection::libev_timer_cb(struct ev_loop *loop, struct ev_timer *watcher, int revents) {
-    auto connection = reinterpret_cast<TcpConnection *>(reinterpret_cast<char*>(watcher) - offsetof(TcpConnection, timer_watcher));
-    connection->timer();
-}
-
 void TcpConnection::stopReadHandler() {
     if (!ev_is_active(&read_watcher)) {
         return;
     }
     Logger::debug("{}stop read handler", prefix(this));
-    ev_io_stop(protocol->loop, &read_watcher);
+    ev_io_stop(loop(), &read_watcher);
 }
 
 void TcpConnection::stopWriteHandler() {
     if (!ev_is_active(&write_watcher)) {
         return;
     }
-    ev_io_stop(protocol->loop, &write_watcher);
+    ev_io_stop(loop(), &write_watcher);
 }
 
 void TcpConnection::startReadHandler() {
@@ -254,44 +453,35 @@ void TcpConnection::startReadHandler() {
         return;
     }
     Logger::debug("{}start read handler", prefix(this));
-    ev_io_start(protocol->loop, &read_watcher);
+    ev_io_start(loop(), &read_watcher);
 }
 
 void TcpConnection::startWriteHandler() {
     if (ev_is_active(&write_watcher)) {
         return;
     }
-    ev_io_start(protocol->loop, &write_watcher);
+    ev_io_start(loop(), &write_watcher);
 }
 
 void TcpConnection::startTimer() {
-    if (timer_active) {
+    if (connectTimer.armed()) {
         return;
     }
     Logger::debug("startTimer");
-    timer_active = true;
-    ev_timer_init(&timer_watcher, libev_timer_cb, 1, 0.);
-    ev_timer_start(protocol->loop, &timer_watcher);
+    timers().start(connectTimer, 1);
 }
 void TcpConnection::stopTimer() {
-    if (!timer_active) {
+    if (!connectTimer.armed()) {
         return;
     }
     Logger::debug("stopTimer");
-    timer_active = false;
-    ev_timer_stop(protocol->loop, &timer_watcher);
+    connectTimer.cancel();
 }
 void TcpConnection::timer() {
     Logger::debug("timer {}", std::to_underlying(state));
     if (state == ConnectionState::INPROGRESS) {
         Logger::debug("INPROGRESS -> TIMEOUT");
-        stopReadHandler();
-        ::close(fd);
-        fd = -1;
-        state = ConnectionState::IDLE;
-        while(!interlock.empty()) {
-            interlock.resume(interlock.begin()->first, make_exception_ptr(TIMEOUT(0, CORBA::CompletionStatus::NO)));
-        }
+        disconnect(make_exception_ptr(TIMEOUT(0, CORBA::CompletionStatus::NO)));
     }
 }
 
@@ -3,10 +3,11 @@
 #include "protocol.hh"
 #include "../connection.hh"
 #include "../stream2packet.hh"
+#include "../sendqueue.hh"
 
+#include <deque>
 #include <memory>
 #include <vector>
-#include <list>
 
 namespace CORBA {
 
@@ -21,39 +22,86 @@ class TcpConnection : public Connection {
         int fd = -1;
         ev_io read_watcher;
         ev_io write_watcher;
-        ev_timer timer_watcher;
-        bool timer_active:1 = false;
+        /**
+         * gives up connecting after a while
+         */
+        TimerWheel::Timer connectTimer;
         static void libev_read_cb(struct ev_loop *loop, struct ev_io *watcher, int revents);
         static void libev_write_cb(struct ev_loop *loop, struct ev_io *watcher, int revents);
-        static void libev_timer_cb(struct ev_loop *loop, struct ev_timer *watcher, int revents);
 
         // stream to packet
         IIOPStream2Packet stream2packet;
 
         // packet to stream
-        std::list<std::unique_ptr<std::vector<char>>> sendBuffer;
-        ssize_t bytesSend = 0;
+        SendQueue sendBuffer;
+        /**
+         * messages larger than fragmentSize, they are split into GIOP 1.2
+         * fragments one at a time so that other messages can be send in
+         * between
+         */
+        std::deque<OutgoingMessage> unfragmented;
+        /**
+         * bytes of unfragmented.front() which have already been queued
+         */
+        size_t fragmentOffset = 0;
+        /**
+         * keeps the connection alive while close() waits for the
+         * CloseConnection message to be written
+         */
+        std::shared_ptr<Connection> lingering;
+        /**
+         * close() waits for the last fragment of unfragmented to be queued
+         * before it queues the CloseConnection message
+         */
+        bool closing = false;
 
     public:
+        /**
+         * see TcpProtocol::eagerWrite
+         */
+        bool eagerWrite = true;
+        /**
+         * see TcpProtocol::readBudget
+         */
+        size_t readBudget = 0x40000;
+        /**
+         * see TcpProtocol::fragmentSize
+         */
+        size_t fragmentSize = 0;
+
         TcpConnection(Protocol *protocol, const char *host, uint16_t port);
         ~TcpConnection();
 
         void accept(int fd);
-        void canWrite();
+        /**
+         * \param eager called from sendv() instead of the write watcher, the
+         *        caller of the message has not been suspended yet
+         */
+        void canWrite(bool eager = false);
         void canRead();
         void timer();
 
         std::function<void(void *buffer, size_t nbyte)> receiver;
 
         void up() override;
-        void send(std::unique_ptr<std::vector<char>> &&) override;
-        
-        void recv(void *buffer, size_t nbyte);
+        void send(std::unique_ptr<Buffer> &&) override;
+        void sendv(std::unique_ptr<Buffer> &&buffer, std::vector<BufferSegment> &&segments) override;
+        void close() override;
+        void releaseSegments() override;
+
+        /**
+         * \param holder keeps buffer valid after the call, see ORB::socketRcvd()
+         */
+        void recv(void *buffer, size_t nbyte, std::shared_ptr<const void> holder = {});
+        size_t receiveBufferBytes() const override { return stream2packet.bufferBytes(); }
 
         void print();
         inline int getFD() { return this->fd; }
 
     private:
+        bool nextFragment();
+        bool queueCloseConnection();
+        void disconnect(std::exception_ptr reason);
         void startReadHandler();
         void stopReadHandler();
         void startWriteHandler();
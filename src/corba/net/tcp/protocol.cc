@@ -11,8 +11,6 @@ using namespace std;
 namespace CORBA {
 namespace detail {
 
-static void libev_accept_cb(struct ev_loop *loop, struct ev_io *watcher, int revents);
-
 static string prefix(TcpProtocol *proto) {
     string result;
     if (proto->orb && proto->orb->logname) {
@@ -26,7 +24,18 @@ TcpProtocol::~TcpProtocol() { shutdown(); }
 void TcpProtocol::listen(const char *host, unsigned port) {
     local.host = host;
     local.port = port;
-    auto sockets = create_listen_socket(host, port);
+    startLoops();
+    if (reusePort && !loops.empty()) {
+        for (auto &eventLoop : loops) {
+            addListeners(host, port, eventLoop);
+        }
+    } else {
+        addListeners(host, port, nullptr);
+    }
+}
+
+void TcpProtocol::addListeners(const char *host, unsigned port, shared_ptr<EventLoop> eventLoop) {
+    auto sockets = create_listen_socket(host, port, backlog, eventLoop != nullptr);
     if (sockets.size() == 0) {
         println("{}TcpProtocol::listen(): {}:{}: {}", prefix(this), host, port, strerror(errno));
         throw CORBA::INITIALIZE(INITIALIZE_TransportError, CORBA::CompletionStatus::YES);
@@ -36,36 +45,92 @@ void TcpProtocol::listen(const char *host, unsigned port) {
         listeners.push_back(make_unique<listen_handler_t>());
         auto &handler = listeners.back();
         handler->protocol = this;
+        handler->eventLoop = eventLoop;
         ev_io_init(&handler->watcher, libev_accept_cb, socket, EV_READ);
-        ev_io_start(loop, &handler->watcher);
+        if (eventLoop && eventLoop->home) {
+            // a worker's watchers are only touched by the thread running it
+            eventLoop->post([eventLoop, watcher = &handler->watcher] { ev_io_start(eventLoop->loop, watcher); });
+        } else {
+            ev_io_start(loop, &handler->watcher);
+        }
     }
 }
 
 void TcpProtocol::shutdown() {
+    // with the worker threads joined their listeners can be stopped from here
+    stopLoops();
     for (auto &listener : listeners) {
         println("TcpProtocol::shutdown() {}", getLocalName(listener->watcher.fd).str());
-        ev_io_stop(loop, &listener->watcher);
+        ev_io_stop(listener->eventLoop ? listener->eventLoop->loop : loop, &listener->watcher);
         close(listener->watcher.fd);
     }
     listeners.clear();
 }
 
+void TcpProtocol::startLoops() {
+    if (threads <= 1 || !loops.empty()) {
+        return;
+    }
+    auto home = make_shared<EventLoop>(loop);
+    loops.push_back(home);
+    for (unsigned i = 1; i < threads; ++i) {
+        loops.push_back(make_shared<EventLoop>(home.get()));
+        loops.back()->start();
+    }
+}
+
+void TcpProtocol::stopLoops() {
+    // the loops are freed once the last connection owned by them is gone
+    for (auto &eventLoop : loops) {
+        eventLoop->stop();
+    }
+    loops.clear();
+}
+
+shared_ptr<EventLoop> TcpProtocol::selectLoop() {
+    if (loops.empty()) {
+        return nullptr;
+    }
+    switch (loopSelection) {
+        case LoopSelection::ROUND_ROBIN:
+            return loops[nextLoop++ % loops.size()];
+        case LoopSelection::LEAST_LOADED: {
+            auto result = loops[0];
+            for (auto &eventLoop : loops) {
+                if (eventLoop->connections < result->connections) {
+                    result = eventLoop;
+                }
+            }
+            return result;
+        }
+    }
+    return nullptr;
+}
+
 shared_ptr<Connection> TcpProtocol::connectOutgoing(const char *host, unsigned port) { 
-    return make_shared<TcpConnection>(this, host, port); 
+    auto conn = make_shared<TcpConnection>(this, host, port);
+    conn->eagerWrite = eagerWrite;
+    conn->readBudget = readBudget;
+    conn->fragmentSize = fragmentSize;
+    return conn;
     // throw runtime_error("not implemented yet");
 }
 
 shared_ptr<Connection> TcpProtocol::connectIncoming(const char *host, unsigned port, int fd) { 
     auto conn = make_shared<TcpConnection>(this, host, port);
+    conn->eagerWrite = eagerWrite;
+    conn->readBudget = readBudget;
+    conn->fragmentSize = fragmentSize;
+    if (auto worker = EventLoop::current()) {
+        conn->owner = worker->shared_from_this();
+    }
     conn->accept(fd);
     return conn;
     // throw runtime_error("not implemented yet");
 }
 
 // called by libev when a client want's to connect
-void libev_accept_cb(struct ev_loop *loop, struct ev_io *watcher, int revents) {
-    // println("incoming: got client");
-    // puts("got client");
+void TcpProtocol::libev_accept_cb(struct ev_loop *loop, struct ev_io *watcher, int revents) {
     if (EV_ERROR & revents) {
         perror("got invalid event");
         return;
@@ -73,24 +138,51 @@ void libev_accept_cb(struct ev_loop *loop, struct ev_io *watcher, int revents) {
 
     auto handler = reinterpret_cast<listen_handler_t *>(watcher);
 
-    struct sockaddr_storage addr;
-    socklen_t addrlen = sizeof(addr);
-    int fd = accept(watcher->fd, (struct sockaddr *)&addr, &addrlen);
-
-    set_non_block(fd);
-    if (set_non_block(fd) == -1 || set_no_delay(fd) == -1) {
-        puts("failed to setup");
-        close(fd);
-        return;
+    // take all pending connections (up to a limit, so that a connection storm
+    // does not starve the loop's other watchers)
+    for (int i = 0; i < 64; ++i) {
+        struct sockaddr_storage addr;
+        socklen_t addrlen = sizeof(addr);
+        int fd = accept_non_block(watcher->fd, (struct sockaddr *)&addr, &addrlen);
+        if (fd == -1) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                perror("accept");
+            }
+            return;
+        }
+        if (set_no_delay(fd) == -1) {
+            puts("failed to setup");
+            close(fd);
+            continue;
+        }
+        handler->protocol->accepted(fd, handler->eventLoop);
     }
+}
 
+void TcpProtocol::accepted(int fd, shared_ptr<EventLoop> eventLoop) {
     auto peer = getPeerName(fd);
-    auto connection = handler->protocol->connectIncoming(peer.host.c_str(), peer.port, fd);
-    handler->protocol->orb->connections.insert(connection);
-    // auto foo = dynamic_pointer_cast<TcpConnection>(connection);
-    // if (foo) foo->accept(fd);
+    if (!eventLoop) {
+        eventLoop = selectLoop();
+    }
+    if (eventLoop && eventLoop->home && !eventLoop->isCurrent()) {
+        // the connection is created on the worker so that it's watchers are
+        // started by the thread running the worker's loop
+        ++eventLoop->connections;
+        eventLoop->post([protocol = this, peer, fd] {
+            auto connection = protocol->connectIncoming(peer.host.c_str(), peer.port, fd);
+            protocol->orb->connections.insert(connection);
+            println("{}accepted new connection {} on worker loop", prefix(protocol), connection->str());
+        });
+        return;
+    }
 
-    println("{}accepted new connection {}", prefix(handler->protocol), connection->str());
+    auto connection = connectIncoming(peer.host.c_str(), peer.port, fd);
+    if (eventLoop) {
+        ++eventLoop->connections;
+        connection->owner = eventLoop;
+    }
+    orb->connections.insert(connection);
+    println("{}accepted new connection {}", prefix(this), connection->str());
 }
 
 }  // namespace detail
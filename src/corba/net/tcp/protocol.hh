@@ -1,6 +1,7 @@
 #pragma once
 
 #include "../protocol.hh"
+#include "../eventloop.hh"
 
 namespace CORBA {
 
@@ -15,21 +16,87 @@ class TcpProtocol;
 struct listen_handler_t {
         ev_io watcher;
         TcpProtocol *protocol;
+        /**
+         * with reusePort: the loop accepting the listener's connections
+         */
+        std::shared_ptr<EventLoop> eventLoop;
+};
+
+/**
+ * how incoming connections are distributed over the event loops
+ */
+enum class LoopSelection {
+    ROUND_ROBIN,
+    /**
+     * the loop owning the fewest connections
+     */
+    LEAST_LOADED
 };
 
 class TcpProtocol : public Protocol {
     private:
         friend class TcpConnection;
-
         std::vector<std::unique_ptr<listen_handler_t>> listeners;
+        static void libev_accept_cb(struct ev_loop *loop, struct ev_io *watcher, int revents);
+
+        /**
+         * when threads > 1: the protocol's loop followed by the worker loops
+         */
+        std::vector<std::shared_ptr<EventLoop>> loops;
+        size_t nextLoop = 0;
+        void startLoops();
+        void stopLoops();
+        std::shared_ptr<EventLoop> selectLoop();
+        void addListeners(const char *host, unsigned port, std::shared_ptr<EventLoop> eventLoop);
+        void accepted(int fd, std::shared_ptr<EventLoop> eventLoop);
 
     public:
+        /**
+         * when the connection's send queue is empty, send() writes the message
+         * right away instead of waiting for the next event loop iteration to
+         * report the socket as writable
+         */
+        bool eagerWrite = true;
+        /**
+         * number of bytes a connection reads before it returns to the event
+         * loop, even though there might be more data available
+         */
+        size_t readBudget = 0x40000;
+        /**
+         * GIOP 1.2 requests and replies larger than this many bytes are send
+         * as fragments of this size, 0 to send them in one piece
+         *
+         * this bounds the receive buffer of the peer and lets other messages
+         * pass in between the fragments
+         */
+        size_t fragmentSize = 0;
+        /**
+         * number of event loops handling incoming connections: the protocol's
+         * loop plus threads - 1 loops running on threads of their own
+         *
+         * each accepted connection is owned by one loop. requests for servants
+         * which are not Skeleton::loopLocal are dispatched on the protocol's
+         * loop.
+         */
+        unsigned threads = 1;
+        LoopSelection loopSelection = LoopSelection::ROUND_ROBIN;
+        /**
+         * when threads > 1: each loop gets a listen socket of it's own
+         * (SO_REUSEPORT) and the kernel distributes the incoming connections
+         * among them instead of the protocol's loop accepting all of them
+         */
+        bool reusePort = false;
+        /**
+         * maximum number of connections waiting to be accepted, per listen socket
+         */
+        int backlog = 16;
+
         TcpProtocol(struct ev_loop *loop) : Protocol(loop) {}
         ~TcpProtocol();
 
         /** listen for incoming CORBA connections */
         void listen(const char *host = nullptr, unsigned port = 2809) override;
-        /** shutdown listen socket */
+        /** shutdown listen socket and stop the worker loops */
         void shutdown() override;
 
         std::shared_ptr<Connection> connectOutgoing(const char *host, unsigned port) override;
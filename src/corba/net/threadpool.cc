@@ -0,0 +1,145 @@
+#include "threadpool.hh"
+
+#include <algorithm>
+
+namespace CORBA {
+
+namespace detail {
+
+ThreadPool::~ThreadPool() { stop(); }
+
+void ThreadPool::start(struct ev_loop *loop) {
+    std::lock_guard lock(mutex);
+    if (started) {
+        return;
+    }
+    if (auto worker = EventLoop::current()) {
+        home = worker->home->shared_from_this();
+    } else {
+        home = std::make_shared<EventLoop>(loop);
+    }
+    for (unsigned i = 0; i < std::max(threads, 1u); ++i) {
+        workers.push_back(std::make_unique<Worker>());
+        workers.back()->loop = std::make_shared<EventLoop>(home.get());
+        workers.back()->loop->start();
+    }
+    started = true;
+}
+
+void ThreadPool::stop() {
+    std::lock_guard lock(mutex);
+    if (!started) {
+        return;
+    }
+    started = false;
+    for (auto &worker : workers) {
+        worker->loop->stop();
+    }
+    workers.clear();
+    home = nullptr;
+}
+
+void ThreadPool::schedule(std::function<void()> &&task) {
+    auto worker = currentWorker();
+    if (!worker) {
+        worker = workers[next++ % workers.size()].get();
+    }
+    {
+        std::lock_guard lock(worker->mutex);
+        worker->tasks.push_back(std::move(task));
+    }
+    wake(worker);
+    // an idle worker will steal the task when the chosen one is busy
+    for (auto &other : workers) {
+        if (other.get() != worker && !other->awake) {
+            wake(other.get());
+            break;
+        }
+    }
+}
+
+void ThreadPool::wake(Worker *worker) {
+    if (!worker->awake.exchange(true)) {
+        worker->loop->post([this, worker] { drain(worker); });
+    }
+}
+
+void ThreadPool::drain(Worker *worker) {
+    std::function<void()> task;
+    for (unsigned n = 0; n < batch; ++n) {
+        if (!pop(worker, task) && !steal(worker, task)) {
+            worker->awake = false;
+            // a task queued after pop() and steal() but before awake was
+            // cleared did not wake us and would otherwise be stranded
+            if (!hasTasks()) {
+                return;
+            }
+            if (worker->awake.exchange(true)) {
+                return;
+            }
+            continue;
+        }
+        scheduling = this;
+        task();
+        scheduling = nullptr;
+        task = nullptr;
+    }
+    // let the loop handle it's other watchers before continuing
+    worker->loop->post([this, worker] { drain(worker); });
+}
+
+bool ThreadPool::pop(Worker *worker, std::function<void()> &task) {
+    std::lock_guard lock(worker->mutex);
+    if (worker->tasks.empty()) {
+        return false;
+    }
+    task = std::move(worker->tasks.front());
+    worker->tasks.pop_front();
+    return true;
+}
+
+bool ThreadPool::steal(Worker *thief, std::function<void()> &task) {
+    // the victim runs it's tasks from the front, take from the back
+    for (auto &victim : workers) {
+        if (victim.get() == thief) {
+            continue;
+        }
+        std::lock_guard lock(victim->mutex);
+        if (!victim->tasks.empty()) {
+            task = std::move(victim->tasks.back());
+            victim->tasks.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ThreadPool::hasTasks() {
+    for (auto &worker : workers) {
+        std::lock_guard lock(worker->mutex);
+        if (!worker->tasks.empty()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::shared_ptr<EventLoop> ThreadPool::serial(const void *key) { return workers[std::hash<const void *>{}(key) % workers.size()]->loop; }
+
+ThreadPool::Worker *ThreadPool::currentWorker() const {
+    if (!started) {
+        return nullptr;
+    }
+    auto current = EventLoop::current();
+    for (auto &worker : workers) {
+        if (worker->loop.get() == current) {
+            return worker.get();
+        }
+    }
+    return nullptr;
+}
+
+bool ThreadPool::isCurrent() const { return currentWorker() != nullptr; }
+
+}  // namespace detail
+}  // namespace CORBA
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "eventloop.hh"
+
+namespace CORBA {
+
+namespace detail {
+
+/**
+ * Worker loops on which the ORB runs servants which are not
+ * ThreadPolicy::SINGLE_THREAD.
+ *
+ * The workers are started by the first request needing them. Replies are
+ * handed back to the loop owning the connection via Connection::post().
+ *
+ * Tasks passed to schedule() are queued on a worker and run in order. A
+ * worker running out of tasks steals them from the other workers. Tasks
+ * scheduled by a task are queued instead of being run recursively and a
+ * worker returns to it's loop after a batch of tasks.
+ *
+ * A coroutine run by a scheduled task which awaits a reply is resumed through
+ * schedule() as well, so it might continue on another worker.
+ */
+class ThreadPool {
+        struct Worker {
+                std::shared_ptr<EventLoop> loop;
+                std::mutex mutex;
+                std::deque<std::function<void()>> tasks;
+                /**
+                 * a drain() is pending or running on the worker's loop
+                 */
+                std::atomic_bool awake = false;
+        };
+
+        std::mutex mutex;
+        std::atomic_bool started = false;
+        std::shared_ptr<EventLoop> home;
+        std::vector<std::unique_ptr<Worker>> workers;
+        std::atomic_size_t next = 0;
+        static inline thread_local ThreadPool *scheduling = nullptr;
+
+        Worker *currentWorker() const;
+        void wake(Worker *worker);
+        void drain(Worker *worker);
+        bool pop(Worker *worker, std::function<void()> &task);
+        bool steal(Worker *thief, std::function<void()> &task);
+        bool hasTasks();
+
+    public:
+        /**
+         * number of worker threads
+         */
+        unsigned threads = 4;
+        /**
+         * number of tasks a worker runs before it returns to it's loop
+         */
+        unsigned batch = 64;
+
+        ~ThreadPool();
+
+        /**
+         * start the workers, loop is the loop run by the application
+         *
+         * must be called from the application's loop or one of the worker
+         * loops handing work to the application's loop
+         */
+        void start(struct ev_loop *loop);
+        /**
+         * stop and join the workers, tasks which have not been run yet are
+         * dropped
+         */
+        void stop();
+        /**
+         * run task on one of the workers, the calling worker when called from
+         * one
+         */
+        void schedule(std::function<void()> &&task);
+        /**
+         * the same worker for the same key, tasks posted to it are not stolen
+         */
+        std::shared_ptr<EventLoop> serial(const void *key);
+        /**
+         * true when called from one of the workers
+         */
+        bool isCurrent() const;
+        /**
+         * the pool running the task passed to schedule() on the calling
+         * thread or nullptr, e.g. to schedule the continuation of a coroutine
+         * running on the pool
+         */
+        static ThreadPool *running() { return scheduling; }
+};
+
+}  // namespace detail
+}  // namespace CORBA
@@ -0,0 +1,222 @@
+#include "timerwheel.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <mutex>
+
+namespace CORBA {
+
+namespace detail {
+
+static std::mutex wheelsMutex;
+static std::map<struct ev_loop *, std::unique_ptr<TimerWheel>> wheels;
+
+TimerWheel &TimerWheel::of(struct ev_loop *loop) {
+    std::lock_guard lock(wheelsMutex);
+    auto &wheel = wheels[loop];
+    if (!wheel) {
+        wheel = std::make_unique<TimerWheel>(loop);
+    }
+    return *wheel;
+}
+
+void TimerWheel::release(struct ev_loop *loop) {
+    std::unique_ptr<TimerWheel> wheel;
+    {
+        std::lock_guard lock(wheelsMutex);
+        auto p = wheels.find(loop);
+        if (p == wheels.end()) {
+            return;
+        }
+        wheel = std::move(p->second);
+        wheels.erase(p);
+    }
+}
+
+TimerWheel::TimerWheel(struct ev_loop *loop, ev_tstamp resolution)
+    : loop(loop), resolution(resolution), slots((1 << FIRST_BITS) + (LEVELS - 1) * (1 << LEVEL_BITS)) {
+    for (auto &sentinel : slots) {
+        sentinel.prev = sentinel.next = &sentinel;
+    }
+    ev_timer_init(&tick_watcher, libev_tick_cb, resolution, 0);
+}
+
+TimerWheel::~TimerWheel() {
+    for (auto &sentinel : slots) {
+        while (sentinel.next != &sentinel) {
+            sentinel.next->cancel();
+        }
+        sentinel.prev = sentinel.next = nullptr;
+    }
+    ev_timer_stop(loop, &tick_watcher);
+}
+
+void TimerWheel::start(Timer &timer, ev_tstamp seconds) {
+    timer.cancel();
+    if (armed == 0) {
+        nextTick = ev_now(loop) + resolution;
+    }
+    // while the ev_timer sleeps, ticks lags behind
+    timer.expires = ticks + pendingTicks() + std::max(uint64_t(1), uint64_t(std::ceil(seconds / resolution)));
+    timer.wheel = this;
+    insert(&timer);
+    if (++armed == 1 || timer.expires < wakeTick) {
+        wakeAt(timer.expires);
+    }
+}
+
+/**
+ * number of ticks which passed but have not been processed yet
+ */
+uint64_t TimerWheel::pendingTicks() const {
+    auto now = ev_now(loop);
+    return nextTick <= now ? uint64_t((now - nextTick) / resolution) + 1 : 0;
+}
+
+/**
+ * number of ticks until the next tick with a timer to fire or to cascade
+ */
+uint64_t TimerWheel::ticksUntilNext() const {
+    constexpr uint64_t FIRST_SLOTS = 1 << FIRST_BITS;
+    uint64_t first = FIRST_SLOTS + 1;
+    for (uint64_t n = 1; n <= FIRST_SLOTS; ++n) {
+        auto &sentinel = slots[(ticks + n) & (FIRST_SLOTS - 1)];
+        if (sentinel.next != &sentinel) {
+            first = n;
+            break;
+        }
+    }
+    // the second level cascades each time the first one wraps, the levels
+    // above when the second one wraps
+    auto cascade = FIRST_SLOTS - (ticks & (FIRST_SLOTS - 1));
+    for (;; cascade += FIRST_SLOTS) {
+        if (first <= cascade) {
+            return first;
+        }
+        auto index = ((ticks + cascade) >> FIRST_BITS) & ((1 << LEVEL_BITS) - 1);
+        auto &sentinel = slots[FIRST_SLOTS + index];
+        if (index == 0 || sentinel.next != &sentinel) {
+            return cascade;
+        }
+    }
+}
+
+void TimerWheel::wakeAt(uint64_t tick) {
+    wakeTick = tick;
+    auto at = nextTick + double(tick - ticks - 1) * resolution - ev_now(loop);
+    ev_timer_stop(loop, &tick_watcher);
+    ev_timer_set(&tick_watcher, std::max(at, 0.0), 0);
+    ev_timer_start(loop, &tick_watcher);
+}
+
+void TimerWheel::insert(Timer *timer) {
+    auto delta = timer->expires > ticks ? timer->expires - ticks : 0;
+    if (delta < (uint64_t(1) << FIRST_BITS)) {
+        link(&slots[timer->expires & ((1 << FIRST_BITS) - 1)], timer);
+        return;
+    }
+    auto expires = delta < MAX_TICKS ? timer->expires : ticks + MAX_TICKS - 1;
+    unsigned level = 1;
+    while (level < LEVELS - 1 && delta >= (uint64_t(1) << (FIRST_BITS + level * LEVEL_BITS))) {
+        ++level;
+    }
+    auto index = (expires >> (FIRST_BITS + (level - 1) * LEVEL_BITS)) & ((1 << LEVEL_BITS) - 1);
+    link(&slots[(1 << FIRST_BITS) + (level - 1) * (1 << LEVEL_BITS) + index], timer);
+}
+
+void TimerWheel::link(Timer *sentinel, Timer *timer) {
+    timer->prev = sentinel->prev;
+    timer->next = sentinel;
+    sentinel->prev->next = timer;
+    sentinel->prev = timer;
+}
+
+void TimerWheel::Timer::unlink() {
+    prev->next = next;
+    next->prev = prev;
+    prev = next = nullptr;
+}
+
+void TimerWheel::Timer::cancel() {
+    if (!wheel) {
+        return;
+    }
+    unlink();
+    if (--wheel->armed == 0) {
+        ev_timer_stop(wheel->loop, &wheel->tick_watcher);
+    }
+    wheel = nullptr;
+}
+
+void TimerWheel::libev_tick_cb(struct ev_loop *loop, struct ev_timer *watcher, int revents) {
+    auto wheel = reinterpret_cast<TimerWheel *>(reinterpret_cast<char *>(watcher) - offsetof(TimerWheel, tick_watcher));
+    ++wheel->woken;
+    // catch up with the ticks passed while sleeping or busy
+    auto now = ev_now(loop);
+    while (wheel->armed != 0 && wheel->nextTick <= now) {
+        wheel->nextTick += wheel->resolution;
+        wheel->advance();
+    }
+    if (wheel->armed != 0) {
+        wheel->wakeAt(wheel->ticks + wheel->ticksUntilNext());
+    }
+}
+
+void TimerWheel::advance() {
+    ++ticks;
+    if ((ticks & ((1 << FIRST_BITS) - 1)) == 0) {
+        cascade();
+    }
+    auto sentinel = &slots[ticks & ((1 << FIRST_BITS) - 1)];
+
+    // move the expired timers to a list of their own, so that a callback
+    // cancelling another expired timer finds it in a list
+    Timer expired;
+    expired.prev = expired.next = &expired;
+    while (sentinel->next != sentinel) {
+        auto timer = sentinel->next;
+        timer->unlink();
+        link(&expired, timer);
+    }
+    while (expired.next != &expired) {
+        auto timer = expired.next;
+        timer->cancel();
+        // the callback may destroy the timer
+        auto callback = timer->callback;
+        if (callback) {
+            callback();
+        }
+    }
+    expired.prev = expired.next = nullptr;
+}
+
+void TimerWheel::cascade() {
+    // move the timers of the next slot of each level down, going up as long
+    // as the level wraps
+    for (unsigned level = 1; level < LEVELS; ++level) {
+        auto index = (ticks >> (FIRST_BITS + (level - 1) * LEVEL_BITS)) & ((1 << LEVEL_BITS) - 1);
+        auto sentinel = &slots[(1 << FIRST_BITS) + (level - 1) * (1 << LEVEL_BITS) + index];
+        Timer pending;
+        pending.prev = pending.next = &pending;
+        while (sentinel->next != sentinel) {
+            auto timer = sentinel->next;
+            timer->unlink();
+            link(&pending, timer);
+        }
+        while (pending.next != &pending) {
+            auto timer = pending.next;
+            timer->unlink();
+            insert(timer);
+        }
+        pending.prev = pending.next = nullptr;
+        if (index != 0) {
+            break;
+        }
+    }
+}
+
+}  // namespace detail
+}  // namespace CORBA
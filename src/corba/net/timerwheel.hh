@@ -0,0 +1,130 @@
+#pragma once
+
+#include <ev.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace CORBA {
+
+namespace detail {
+
+/**
+ * Timers of one libev loop (connect timeouts, call deadlines, ...) kept in a
+ * hierarchical timer wheel.
+ *
+ * A single ev_timer advances the wheel, so starting and cancelling a timer is
+ * O(1) instead of an ev_timer each going through libev's heap. It is armed
+ * for the next tick with work to do, i.e. an occupied slot of the first level
+ * or the cascade of one above, hence idle timers do not wake the loop every
+ * resolution seconds. Ticks passed while sleeping are caught up on wakeup.
+ *
+ * The first level has a slot for each of the next 256 ticks, each of the
+ * three levels above has 64 slots covering 64 slots of the level below. When
+ * the level below wraps, the timers of the next slot are moved down. Timers
+ * further away than the top level (about 7 days with the default resolution)
+ * wait in it's last slot.
+ *
+ * A wheel must only be used from the thread running it's loop.
+ */
+class TimerWheel {
+    public:
+        /**
+         * a timer is unlinked from the wheel when it fires, is cancelled or
+         * destroyed
+         */
+        class Timer {
+                friend class TimerWheel;
+                Timer *prev = nullptr;
+                Timer *next = nullptr;
+                TimerWheel *wheel = nullptr;
+                /**
+                 * the tick at which the timer fires
+                 */
+                uint64_t expires = 0;
+                void unlink();
+
+            public:
+                std::function<void()> callback;
+
+                Timer() = default;
+                Timer(std::function<void()> &&callback) : callback(std::move(callback)) {}
+                Timer(const Timer &) = delete;
+                Timer &operator=(const Timer &) = delete;
+                ~Timer() { cancel(); }
+
+                bool armed() const { return wheel != nullptr; }
+                void cancel();
+        };
+
+        struct ev_loop *const loop;
+        const ev_tstamp resolution;
+
+        TimerWheel(struct ev_loop *loop, ev_tstamp resolution = 0.01);
+        TimerWheel(const TimerWheel &) = delete;
+        TimerWheel &operator=(const TimerWheel &) = delete;
+        ~TimerWheel();
+
+        /**
+         * (re)start timer to call it's callback after seconds
+         */
+        void start(Timer &timer, ev_tstamp seconds);
+        /**
+         * number of armed timers
+         */
+        size_t size() const { return armed; }
+        /**
+         * number of times the wheel's ev_timer woke the loop
+         */
+        size_t wakeups() const { return woken; }
+
+        /**
+         * the wheel of loop, created on first use
+         */
+        static TimerWheel &of(struct ev_loop *loop);
+        /**
+         * destroy the wheel of loop, e.g. before the loop is destroyed
+         */
+        static void release(struct ev_loop *loop);
+
+    private:
+        static constexpr unsigned LEVELS = 4;
+        static constexpr unsigned FIRST_BITS = 8;
+        static constexpr unsigned LEVEL_BITS = 6;
+        static constexpr uint64_t MAX_TICKS = uint64_t(1) << (FIRST_BITS + (LEVELS - 1) * LEVEL_BITS);
+
+        ev_timer tick_watcher;
+        /**
+         * sentinels of the slots' circular lists, the first level followed by
+         * the levels above
+         */
+        std::vector<Timer> slots;
+        /**
+         * the tick processed last
+         */
+        uint64_t ticks = 0;
+        size_t armed = 0;
+        size_t woken = 0;
+        /**
+         * the time of tick ticks + 1
+         */
+        ev_tstamp nextTick = 0;
+        /**
+         * the tick the ev_timer is armed for
+         */
+        uint64_t wakeTick = 0;
+
+        static void libev_tick_cb(struct ev_loop *loop, struct ev_timer *watcher, int revents);
+        uint64_t pendingTicks() const;
+        uint64_t ticksUntilNext() const;
+        void wakeAt(uint64_t tick);
+        void advance();
+        void cascade();
+        void insert(Timer *timer);
+        void link(Timer *sentinel, Timer *timer);
+};
+
+}  // namespace detail
+}  // namespace CORBA
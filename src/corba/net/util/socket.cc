@@ -21,7 +21,7 @@ void ignore_sig_pipe() {
     sigaction(SIGPIPE, &act, 0);
 }
 
-std::vector<int> create_listen_socket(const char *hostname, uint16_t port) {
+std::vector<int> create_listen_socket(const char *hostname, uint16_t port, int backlog, bool reusePort) {
     std::vector<int> result;
 
     struct addrinfo hints;
@@ -59,12 +59,23 @@ std::vector<int> create_listen_socket(const char *hostname, uint16_t port) {
             close(fd);
             continue;
         }
+        if (reusePort && setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &val, static_cast<socklen_t>(sizeof(val))) == -1) {
+            std::cerr << "FAILED TO REUSE PORT: " << strerror(errno) << std::endl;
+            close(fd);
+            continue;
+        }
+        // the listen socket is drained until accept() reports EAGAIN
+        if (set_non_block(fd) == -1) {
+            std::cerr << "FAILED TO SET SOCKET TO NON-BLOCKING: " << strerror(errno) << std::endl;
+            close(fd);
+            continue;
+        }
         if (bind(fd, rp->ai_addr, rp->ai_addrlen) == -1) {
             std::cerr << "FAILED TO BIND SOCKET: " << strerror(errno) << std::endl;
             close(fd);
             continue;
         }
-        if (listen(fd, 16) == -1) {
+        if (listen(fd, backlog) == -1) {
             std::cerr << "FAILED TO LISTEN ON SOCKET: " << strerror(errno) << std::endl;
             close(fd);
             continue;
@@ -82,6 +93,23 @@ std::vector<int> create_listen_socket(const char *hostname, uint16_t port) {
     return result;
 }
 
+int accept_non_block(int fd, struct sockaddr *addr, socklen_t *addrlen) {
+#ifdef SOCK_NONBLOCK
+    int client;
+    while ((client = accept4(fd, addr, addrlen, SOCK_NONBLOCK | SOCK_CLOEXEC)) == -1 && errno == EINTR);
+    return client;
+#else
+    // e.g. macOS has no accept4()
+    int client;
+    while ((client = accept(fd, addr, addrlen)) == -1 && errno == EINTR);
+    if (client != -1 && set_non_block(client) == -1) {
+        close(client);
+        return -1;
+    }
+    return client;
+#endif
+}
+
 int connect_to(const char *host, uint16_t port) {
     int fd = -1;
     int r;
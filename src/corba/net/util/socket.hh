@@ -1,5 +1,7 @@
 #pragma once
 
+#include <sys/socket.h>
+
 #include <cstdint>
 #include <print>
 #include <string>
@@ -17,7 +19,17 @@ struct SocketHostPort : HostAndPort {
         int fd;
 };
 
-std::vector<int> create_listen_socket(const char *hostname, uint16_t port);
+/**
+ * create non-blocking sockets listening on all addresses of hostname
+ *
+ * with reusePort several sockets can listen on the same port (SO_REUSEPORT)
+ * and the kernel distributes the incoming connections among them
+ */
+std::vector<int> create_listen_socket(const char *hostname, uint16_t port, int backlog = 16, bool reusePort = false);
+/**
+ * accept a connection and return it as a non-blocking socket
+ */
+int accept_non_block(int fd, struct sockaddr *addr, socklen_t *addrlen);
 int connect_to(const char *host, uint16_t port);
 
 void ignore_sig_pipe();
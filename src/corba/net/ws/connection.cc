@@ -30,7 +30,9 @@ static string prefix(WsConnection *conn) {
 }
 
 WsConnection::WsConnection(Protocol *protocol, const char *host, uint16_t port, WsConnectionState initialState)
-    : Connection(protocol, host, port), wsstate(initialState) {}
+    : Connection(protocol, host, port), wsstate(initialState) {
+    connectTimer.callback = [this] { timer(); };
+}
 
 WsConnection::~WsConnection() {
     stopTimer();
@@ -46,7 +48,13 @@ WsConnection::~WsConnection() {
     }
 }
 
-void WsConnection::send(unique_ptr<vector<char>> &&buffer) {
+void WsConnection::send(unique_ptr<Buffer> &&buffer) {
+    if (!isOwnerThread()) {
+        // e.g. the reply of a servant which is not loop-local
+        auto message = make_shared<unique_ptr<Buffer>>(move(buffer));
+        post([self = shared_from_this(), message] { self->send(move(*message)); });
+        return;
+    }
     lock_guard guard(send_mutex);
     auto size = buffer->size();
     sendBuffer.push_back(move(buffer));
@@ -294,6 +302,10 @@ void WsConnection::flushSendBuffer() {
         }
     }
     int r = wslay_event_send(ctx);
+    // wslay_event_queue_msg() made a copy, hence the buffers can be reused
+    for (auto &buffer : sendBuffer) {
+        bufferPool.release(move(buffer));
+    }
     sendBuffer.clear(); // FIXME: this might be premature???
     if (r < 0) {
         Logger::error("{}WsConnection::flushSendBuffer(): wslay_event_send() error {}", prefix(this), wslay_error_to_string(r));
@@ -460,17 +472,12 @@ void WsConnection::libev_write_cb(struct ev_loop *loop, struct ev_io *watcher, i
     connection->canWrite();
 }
 
-void WsConnection::libev_timer_cb(struct ev_loop *loop, struct ev_timer *watcher, int revents) {
-    auto connection = reinterpret_cast<WsConnection *>(reinterpret_cast<char *>(watcher) - offsetof(WsConnection, timer_watcher));
-    connection->timer();
-}
-
 void WsConnection::stopReadHandler() {
     if (!ev_is_active(&read_watcher)) {
         return;
     }
     Logger::debug("{}WsConnection::stopReadHandler()", prefix(this));
-    ev_io_stop(protocol->loop, &read_watcher);
+    ev_io_stop(loop(), &read_watcher);
 }
 
 void WsConnection::startWriteHandler() {
@@ -478,7 +485,7 @@ void WsConnection::startWriteHandler() {
         return;
     }
     Logger::debug("{}WsConnection::startWriteHandler()", prefix(this));
-    ev_io_start(protocol->loop, &write_watcher);
+    ev_io_start(loop(), &write_watcher);
 }
 
 void WsConnection::stopWriteHandler() {
@@ -486,7 +493,7 @@ void WsConnection::stopWriteHandler() {
         return;
     }
     Logger::debug("{}WsConnection::stopWriteHandler()", prefix(this));
-    ev_io_stop(protocol->loop, &write_watcher);
+    ev_io_stop(loop(), &write_watcher);
 }
 
 void WsConnection::startReadHandler() {
@@ -494,25 +501,22 @@ void WsConnection::startReadHandler() {
         return;
     }
     Logger::debug("{}WsConnection::startReadHandler()", prefix(this));
-    ev_io_start(protocol->loop, &read_watcher);
+    ev_io_start(loop(), &read_watcher);
 }
 
 void WsConnection::startTimer() {
-    if (timer_active) {
+    if (connectTimer.armed()) {
         return;
     }
     Logger::debug("{}WsConnection::startTimer()", prefix(this));
-    timer_active = true;
-    ev_timer_init(&timer_watcher, libev_timer_cb, 5, 0.);
-    ev_timer_start(protocol->loop, &timer_watcher);
+    timers().start(connectTimer, 5);
 }
 void WsConnection::stopTimer() {
-    if (!timer_active) {
+    if (!connectTimer.armed()) {
         return;
     }
     Logger::debug("{}WsConnection::stopTimer()", prefix(this));
-    timer_active = false;
-    ev_timer_stop(protocol->loop, &timer_watcher);
+    connectTimer.cancel();
 }
 void WsConnection::timer() {
     Logger::debug("{}WsConnection::timer(): {}", prefix(this), std::to_underlying(state));
@@ -522,9 +526,7 @@ void WsConnection::timer() {
         ::close(fd);
         fd = -1;
         state = ConnectionState::IDLE;
-        while (!interlock.empty()) {
-            interlock.resume(interlock.begin()->first, make_exception_ptr(TIMEOUT(0, CORBA::CompletionStatus::NO)));
-        }
+        outstanding.resumeAll(make_exception_ptr(TIMEOUT(0, CORBA::CompletionStatus::NO)));
     }
 }
 
@@ -26,18 +26,19 @@ class WsConnection : public Connection {
         int fd = -1;
         ev_io read_watcher;
         ev_io write_watcher;
-        ev_timer timer_watcher;
-        bool timer_active:1 = false;
+        /**
+         * gives up connecting after a while
+         */
+        TimerWheel::Timer connectTimer;
         static void libev_read_cb(struct ev_loop *loop, struct ev_io *watcher, int revents);
         static void libev_write_cb(struct ev_loop *loop, struct ev_io *watcher, int revents);
-        static void libev_timer_cb(struct ev_loop *loop, struct ev_timer *watcher, int revents);
 
         //------- THIS CRASHES IT
         WsConnectionState wsstate;
         std::string headers;
         std::string client_key;
         wslay_event_context_ptr ctx;
-        std::list<std::unique_ptr<std::vector<char>>> sendBuffer;
+        std::list<std::unique_ptr<Buffer>> sendBuffer;
 
         void httpClientSend();
         void httpServerRcvd();
@@ -57,7 +58,7 @@ class WsConnection : public Connection {
         std::function<void(void *buffer, size_t nbyte)> receiver;
 
         void up() override;
-        void send(std::unique_ptr<std::vector<char>> &&) override;
+        void send(std::unique_ptr<Buffer> &&) override;
         
         void recv(void *buffer, size_t nbyte);
 
@@ -11,6 +11,9 @@ shared_ptr<Connection> WsProtocol::connectOutgoing(const char *host, unsigned po
 }
 shared_ptr<Connection> WsProtocol::connectIncoming(const char *host, unsigned port, int fd) { 
     auto conn = make_shared<WsConnection>(this, host, port, WsConnectionState::HTTP_SERVER); 
+    if (auto worker = EventLoop::current()) {
+        conn->owner = worker->shared_from_this();
+    }
     conn->accept(fd);
     return conn;
 }
@@ -65,9 +65,17 @@ ORB::~ORB() {
 }
 
 void ORB::shutdown() {
-    servants.clear();
+    {
+        std::unique_lock lock(servantsMutex);
+        servants.clear();
+    }
     namingService = nullptr;
 
+    // stop the worker loops before the connections owned by them are destroyed
+    for (auto proto : protocols) {
+        proto->shutdown();
+    }
+    threadPool.stop();
     connections.clear();
     for (auto proto : protocols) {
         delete proto;
@@ -181,6 +189,7 @@ std::shared_ptr<detail::Connection> ORB::getConnection(string host, uint16_t por
             // }
         }
         auto connection = proto->connectOutgoing(host.c_str(), port);
+        connection->outgoing = true;
         Logger::debug("{}created {}", prefix(this), connection->str());
         connections.insert(connection);
         return connection;
@@ -188,37 +197,215 @@ std::shared_ptr<detail::Connection> ORB::getConnection(string host, uint16_t por
     throw runtime_error(format("failed to allocate connection to {}:{}", host, port));
 }
 
-void ORB::close(detail::Connection *connection) {}
+void ORB::close(detail::Connection *connection) { connections.close(connection); }
+
+/**
+ * Pick the connection for a call to the stub's peer.
+ *
+ * Regular calls go to the connection with the least outstanding calls, while
+ * all of them are busy another one is opened until there are
+ * connectionsPerPeer. Bulk calls go to a connection of their own so that large
+ * messages do not delay the others. Request ids are counted per connection,
+ * hence they stay unique on each of them.
+ *
+ * Nothing tells when a oneway call has been processed by the peer, hence after
+ * the first oneway call all calls of the stub use the same connection so that
+ * they arrive in the order they were made. The stub picks a new connection
+ * once that one has been closed.
+ */
+std::shared_ptr<detail::Connection> ORB::connectionFor(Stub *stub, size_t sizeHint, bool oneway) {
+    auto primary = stub->connection;
+    bool bulk = stub->bulk || (bulkThreshold != 0 && sizeHint >= bulkThreshold);
+    // accepted connections, e.g. for BiDir IIOP, are not multiplied
+    if (!primary->outgoing) {
+        return primary;
+    }
+    std::lock_guard lock(stub->mutex);
+    if (auto lane = stub->lane.lock()) {
+        if (!lane->closed) {
+            return lane;
+        }
+        stub->lane.reset();
+    }
+    auto connection = connectionsPerPeer <= 1 && !bulk ? primary : connectionForLane(primary, bulk);
+    if (oneway) {
+        stub->lane = connection;
+    }
+    return connection;
+}
+
+/**
+ * the outgoing connection to primary's peer with the least outstanding calls,
+ * a new one while all are busy and there are less than connectionsPerPeer
+ */
+std::shared_ptr<detail::Connection> ORB::connectionForLane(const std::shared_ptr<detail::Connection> &primary, bool bulk) {
+    std::shared_ptr<detail::Connection> best;
+    size_t lanes = 0;
+    for (auto &c : connections.findAllByRemote(primary->remote.host.c_str(), primary->remote.port)) {
+        if (!c->outgoing || c->bulk != bulk || c->protocol != primary->protocol) {
+            continue;
+        }
+        ++lanes;
+        if (!best || c->outstandingCalls() < best->outstandingCalls()) {
+            best = c;
+        }
+    }
+    if (best && (best->outstandingCalls() == 0 || lanes >= (bulk ? 1 : connectionsPerPeer))) {
+        return best;
+    }
+    auto connection = primary->protocol->connectOutgoing(primary->remote.host.c_str(), primary->remote.port);
+    connection->outgoing = true;
+    connection->bulk = bulk;
+    Logger::debug("{}created {}{}", prefix(this), bulk ? "bulk connection " : "", connection->str());
+    connections.insert(connection);
+    return connection;
+}
+
+/**
+ * estimate the size of a request: the GIOP & request header, a service context,
+ * object key and operation plus the encoded arguments as provided by the stub
+ *
+ * stubs generated by the IDL compiler do not provide a hint, for them the sizes
+ * of the operation's previous request are used. the buffer is not reserved
+ * beyond what the connection's buffer pool keeps.
+ */
+static Stub::RequestSize requestSizeHint(Stub *stub, detail::Connection *connection, const char *operation, size_t sizeHint) {
+    if (sizeHint == 0) {
+        auto last = stub->lastRequestSize(operation);
+        last.length = std::min(last.length, connection->bufferPool.maxBufferCapacity);
+        return last;
+    }
+    auto size = 96 + stub->get_object_key().size() + strlen(operation) + sizeHint;
+    return {size, size};
+}
+
+/**
+ * a twoway call made on a thread not owning the connection, shared with the
+ * tasks run on the owning thread
+ */
+struct ForeignCall {
+        std::unique_ptr<detail::Buffer> buffer;
+        std::vector<detail::BufferSegment> segments;
+        detail::TimerWheel::Timer deadline;
+        /**
+         * the call has been resumed, only used on the owning thread
+         */
+        bool replied = false;
+        ForeignCall(std::unique_ptr<detail::Buffer> &&buffer, std::vector<detail::BufferSegment> &&segments)
+            : buffer(std::move(buffer)), segments(std::move(segments)) {}
+};
+
+/**
+ * send a ForeignCall's request and start it's deadline on the thread owning
+ * the connection
+ */
+static void sendForeignCall(const std::shared_ptr<detail::Connection> &connection, uint32_t requestId, const std::shared_ptr<ForeignCall> &call,
+                            std::chrono::milliseconds timeout, bool referencesCaller) {
+    if (call->replied) {
+        // e.g. the connection was lost in the meantime
+        return;
+    }
+    try {
+        connection->sendv(move(call->buffer), move(call->segments));
+    } catch (std::exception &ex) {
+        Logger::debug("ORB::_twowayCall(): failed to send request {}: {}", requestId, ex.what());
+        connection->outstanding.resume(requestId, std::current_exception());
+        return;
+    }
+    if (timeout.count() != 0) {
+        call->deadline.callback = [connection = connection.get(), requestId, referencesCaller] {
+            if (referencesCaller) {
+                connection->releaseSegments();
+            }
+            connection->outstanding.resume(requestId, std::make_exception_ptr(TIMEOUT(0, CompletionStatus::MAYBE)));
+        };
+        connection->timers().start(call->deadline, std::chrono::duration<double>(timeout).count());
+    }
+}
+
+static thread_local std::optional<std::chrono::milliseconds> currentRoundtripTimeout;
+
+RoundtripTimeout::RoundtripTimeout(std::chrono::milliseconds timeout) : previous(currentRoundtripTimeout) { currentRoundtripTimeout = timeout; }
+RoundtripTimeout::~RoundtripTimeout() { currentRoundtripTimeout = previous; }
+std::optional<std::chrono::milliseconds> RoundtripTimeout::current() { return currentRoundtripTimeout; }
 
-async<GIOPDecoder *> ORB::_twowayCall(Stub *stub, const char *operation, std::function<void(GIOPEncoder &)> encode) {
+async<std::shared_ptr<GIOPDecoder>> ORB::_twowayCall(Stub *stub, const char *operation, std::function<void(GIOPEncoder &)> encode, size_t sizeHint) {
     // Logger::debug("ORB::_twowayCall(stub, \"{}\", ...) ENTER", operation);
     if (stub->connection == nullptr) {
         throw runtime_error("ORB::_twowayCall(): the stub has no connection");
     }
-    auto requestId = stub->connection->requestId.fetch_add(2);  // TODO: only increment by 2 during BiDir???
+    auto estimatedSize = requestSizeHint(stub, stub->connection.get(), operation, sizeHint);
+    auto connection = connectionFor(stub, estimatedSize.size);
+    auto timeout = RoundtripTimeout::current().value_or(stub->roundtripTimeout.count() != 0 ? stub->roundtripTimeout : roundtripTimeout);
+    connection->touch();
+    auto requestId = connection->requestId.fetch_add(2);  // TODO: only increment by 2 during BiDir???
     // printf("CONNECTION %p %s:%u -> %s:%u requestId=%u\n", static_cast<void *>(stub->connection), stub->connection->localAddress().c_str(),
     //        stub->connection->localPort(), stub->connection->remoteAddress().c_str(), stub->connection->remotePort(), stub->connection->requestId);
 
-    GIOPEncoder encoder(stub->connection.get());
+    GIOPEncoder encoder(connection.get(), estimatedSize.length);
     auto responseExpected = true;
     encoder.encodeRequest(stub->objectKey, operation, requestId, responseExpected);
     encode(encoder);
     encoder.setGIOPHeader(MessageType::REQUEST);  // THIS IS TOTAL BOLLOCKS BECAUSE OF THE RESIZE IN IT...
+    stub->lastRequestSize(operation, {encoder.buffer.length(), encoder.buffer.size()});
     Logger::debug("ORB::_twowayCall(stub, \"{}\", ...) SEND REQUEST objectKey=\"{}\", operation=\"{}\", requestId={}", operation, stub->objectKey, operation,
                   requestId);
-    try {
-        stub->connection->send(move(encoder.buffer._data));
-    } catch (COMM_FAILURE &ex) {
-        auto h = exceptionHandler.find(stub);
-        if (h != exceptionHandler.end()) {
-            Logger::debug("found a global exception handler for the object");
-            h->second();
-            // TODO: the callback might drop the object's reference, which in turn should delete it from 'exceptionHandler'
+    bool referencesCaller = !encoder.buffer.segments.empty();
+    std::variant<std::shared_ptr<GIOPDecoder>, std::exception_ptr> ret;
+    if (connection->isOwnerThread()) {
+        try {
+            // segments referenced by the encoder stay valid as the caller awaits the reply
+            connection->sendv(move(encoder.buffer._data), move(encoder.buffer.segments));
+        } catch (COMM_FAILURE &ex) {
+            auto h = exceptionHandler.find(stub);
+            if (h != exceptionHandler.end()) {
+                Logger::debug("found a global exception handler for the object");
+                h->second();
+                // TODO: the callback might drop the object's reference, which in turn should delete it from 'exceptionHandler'
+            }
         }
-    }
 
-    Logger::debug("ORB::_twowayCall(stub, \"{}\", ...) SUSPEND", operation);
-    auto ret = co_await stub->connection->interlock.suspend(requestId);
+        detail::TimerWheel::Timer deadline;
+        if (timeout.count() != 0) {
+            deadline.callback = [connection = connection.get(), requestId, referencesCaller] {
+                if (referencesCaller) {
+                    // the request might still be queued and the caller's memory is gone once it's resumed
+                    connection->releaseSegments();
+                }
+                // frees the request's slot, a late reply is dropped
+                connection->outstanding.resume(requestId, std::make_exception_ptr(TIMEOUT(0, CompletionStatus::MAYBE)));
+            };
+            connection->timers().start(deadline, std::chrono::duration<double>(timeout).count());
+        }
+
+        Logger::debug("ORB::_twowayCall(stub, \"{}\", ...) SUSPEND", operation);
+        ret = co_await connection->outstanding.suspend(requestId);
+        deadline.cancel();
+    } else {
+        // e.g. a servant on the thread pool: the connection's send queue and
+        // timers belong to the owning loop, which gets the request once this
+        // coroutine waits, and the reply resumes it on the calling thread or,
+        // when called by a task of the thread pool, on any of it's workers
+        auto caller = detail::EventLoop::current() ? detail::EventLoop::current() : connection->owner->home;
+        auto pool = detail::ThreadPool::running();
+        auto call = std::make_shared<ForeignCall>(move(encoder.buffer._data), move(encoder.buffer.segments));
+        Logger::debug("ORB::_twowayCall(stub, \"{}\", ...) SUSPEND", operation);
+        ret = co_await connection->outstanding.suspend(
+            requestId,
+            [caller, pool, call](std::coroutine_handle<> handle) {
+                // called on the owning thread
+                call->replied = true;
+                call->deadline.cancel();
+                if (pool) {
+                    pool->schedule([handle] { detail::ResumeQueue::resume(handle); });
+                } else {
+                    caller->post([handle] { detail::ResumeQueue::resume(handle); });
+                }
+            },
+            [connection, requestId, call, timeout, referencesCaller] {
+                connection->post([connection, requestId, call, timeout, referencesCaller] { sendForeignCall(connection, requestId, call, timeout, referencesCaller); });
+            });
+    }
     Logger::debug("ORB::_twowayCall(stub, \"{}\", ...) RESUME", operation);
 
     if (std::holds_alternative<std::exception_ptr>(ret)) {
@@ -226,7 +413,7 @@ async<GIOPDecoder *> ORB::_twowayCall(Stub *stub, const char *operation, std::fu
         std::rethrow_exception(std::get<std::exception_ptr>(ret));
     }
 
-    GIOPDecoder *decoder = std::get<GIOPDecoder *>(ret);
+    auto decoder = std::get<std::shared_ptr<GIOPDecoder>>(std::move(ret));
 
     // move parts of this into a separate function so that it can be unit tested
     switch (decoder->replyStatus) {
@@ -299,9 +486,9 @@ async<GIOPDecoder *> ORB::_twowayCall(Stub *stub, const char *operation, std::fu
             } else if (exceptionId == "IDL:omg.org/CORBA/COMM_FAILURE:1.0") {
                 throw COMM_FAILURE(minorCodeValue, completionStatus);
             } else if (exceptionId == "IDL:mark13.org/CORBA/GENERIC:1.0") {
-                throw runtime_error(format("Remote CORBA exception from {}: {}", stub->connection->str(), decoder->readString()));
+                throw runtime_error(format("Remote CORBA exception from {}: {}", connection->str(), decoder->readString()));
             } else {
-                throw runtime_error(format("CORBA System Exception {} from {}", exceptionId, stub->connection->str()));
+                throw runtime_error(format("CORBA System Exception {} from {}", exceptionId, connection->str()));
             }
         } break;
         default:
@@ -313,19 +500,31 @@ async<GIOPDecoder *> ORB::_twowayCall(Stub *stub, const char *operation, std::fu
     co_return decoder;
 }
 
-void ORB::onewayCall(Stub *stub, const char *operation, std::function<void(GIOPEncoder &)> encode) {
+void ORB::onewayCall(Stub *stub, const char *operation, std::function<void(GIOPEncoder &)> encode, size_t sizeHint) {
     if (stub->connection == nullptr) {
         throw runtime_error("ORB::onewayCall(): the stub has no connection");
     }
-    auto requestId = stub->connection->requestId.fetch_add(2);
-    GIOPEncoder encoder(stub->connection.get());
+    auto estimatedSize = requestSizeHint(stub, stub->connection.get(), operation, sizeHint);
+    auto connection = connectionFor(stub, estimatedSize.size, true);
+    connection->touch();
+    auto requestId = connection->requestId.fetch_add(2);
+    GIOPEncoder encoder(connection.get(), estimatedSize.length);
     auto responseExpected = false;
     encoder.encodeRequest(stub->objectKey, operation, requestId, responseExpected);
     encode(encoder);
     encoder.setGIOPHeader(MessageType::REQUEST);
+    stub->lastRequestSize(operation, {encoder.buffer.length(), encoder.buffer.size()});
 
     try {
-        stub->connection->send(move(encoder.buffer._data));
+        // nothing guarantees that segments outlive a oneway call, hence copy them
+        auto message = connection->flatten(move(encoder.buffer._data), move(encoder.buffer.segments));
+        if (connection->isOwnerThread()) {
+            connection->send(move(message));
+        } else {
+            // e.g. called by a servant on the thread pool, the send queue belongs to the owner
+            auto shared = make_shared<unique_ptr<detail::Buffer>>(move(message));
+            connection->post([connection, shared] { connection->send(move(*shared)); });
+        }
     } catch (COMM_FAILURE &ex) {
         auto h = exceptionHandler.find(stub);
         if (h != exceptionHandler.end()) {
@@ -336,23 +535,286 @@ void ORB::onewayCall(Stub *stub, const char *operation, std::function<void(GIOPE
     }
 }
 
-void ORB::socketRcvd(detail::Connection *connection, const void *buffer, size_t size) {
+namespace detail {
+
+/**
+ * a message which outlives ORB::socketRcvd(), e.g. a reply whose caller is
+ * resumed later or a request on it's way to the servant's thread
+ */
+struct ReceivedMessage {
+        /**
+         * keeps the message valid, the decoder points into it
+         */
+        std::shared_ptr<const void> holder;
+        CDRDecoder data;
+        /**
+         * continues where from left off
+         */
+        GIOPDecoder decoder;
+        ReceivedMessage(const GIOPDecoder &from, std::shared_ptr<const void> &&aHolder);
+};
+
+ReceivedMessage::ReceivedMessage(const GIOPDecoder &from, std::shared_ptr<const void> &&aHolder)
+    : holder(std::move(aHolder)), data(from.buffer), decoder(data) {
+    decoder.connection = from.connection;
+    decoder.majorVersion = from.majorVersion;
+    decoder.minorVersion = from.minorVersion;
+    decoder.m_type = from.m_type;
+    decoder.m_length = from.m_length;
+    decoder.requestId = from.requestId;
+    decoder.replyStatus = from.replyStatus;
+}
+
+/**
+ * a request on it's way from the thread owning the connection to the servant,
+ * the decoder is positioned at the arguments
+ */
+struct IncomingRequest : public ReceivedMessage {
+        std::unique_ptr<const RequestHeader> header;
+        /**
+         * the reply, drawn from the connection's buffer pool on the owning thread
+         */
+        GIOPEncoder encoder;
+        /**
+         * counts the request as pending on connection while it exists
+         */
+        std::shared_ptr<Connection> connection;
+        /**
+         * the arguments have been passed to the servant's _stream() handler,
+         * see Skeleton::_streamed()
+         */
+        bool streamed = false;
+        /**
+         * thrown by the _stream() handler
+         */
+        std::exception_ptr error;
+        IncomingRequest(const GIOPDecoder &from, std::unique_ptr<const RequestHeader> &&aHeader, std::shared_ptr<const void> &&aHolder);
+        ~IncomingRequest();
+};
+
+IncomingRequest::IncomingRequest(const GIOPDecoder &from, std::unique_ptr<const RequestHeader> &&aHeader, std::shared_ptr<const void> &&aHolder)
+    : ReceivedMessage(from, std::move(aHolder)), header(std::move(aHeader)), encoder(from.connection), connection(from.connection->shared_from_this()) {
+    ++connection->pendingRequests;
+    encoder.majorVersion = from.majorVersion;
+    encoder.minorVersion = from.minorVersion;
+    encoder.skipReplyHeader();
+}
+
+IncomingRequest::~IncomingRequest() {
+    // the idle timeout starts once the reply has been send
+    connection->touch();
+    --connection->pendingRequests;
+}
+
+}  // namespace detail
+
+/**
+ * complete a request whose arguments have been streamed to the servant
+ */
+static async<> completeStreamed(std::shared_ptr<Skeleton> servant, std::shared_ptr<detail::IncomingRequest> incoming) {
+    if (incoming->error) {
+        std::rethrow_exception(incoming->error);
+    }
+    co_await servant->_streamed(incoming->header->operation, incoming->encoder);
+}
+
+/**
+ * run dispatch() on the thread selected by the servant's ThreadPolicy
+ */
+void ORB::schedule(std::shared_ptr<detail::Connection> connection, std::shared_ptr<Skeleton> servant, std::shared_ptr<detail::IncomingRequest> incoming) {
+    auto task = [this, connection, servant, incoming] { dispatch(connection, servant, incoming); };
+    if (servant->threadPolicy != ThreadPolicy::SINGLE_THREAD) {
+        threadPool.start(connection->protocol->loop);
+        if (servant->threadPolicy == ThreadPolicy::THREAD_POOL) {
+            threadPool.schedule(std::move(task));
+        } else {
+            threadPool.serial(connection.get())->post(std::move(task));
+        }
+        return;
+    }
+    if (!servant->loopLocal) {
+        if (auto worker = detail::EventLoop::current()) {
+            // dispatch on the home loop, the reply is handed back by the connection
+            worker->home->post(std::move(task));
+            return;
+        }
+    }
+    task();
+}
+
+/**
+ * call the servant with a request decoded by socketRcvd() and send the reply
+ *
+ * runs on the thread selected by the servant's ThreadPolicy, hence it must
+ * not touch state owned by the connection's thread
+ */
+void ORB::dispatch(std::shared_ptr<detail::Connection> connection, std::shared_ptr<Skeleton> servant, std::shared_ptr<detail::IncomingRequest> incoming) {
+    auto request = incoming->header.get();
+    bool responseExpected = request->responseExpected;
+    uint32_t requestId = request->requestId;
+    try {
+        // move parts of this into a separate function so that it can be unit tested
+        // std::cerr << "CALL SERVANT" << std::endl;
+        // incoming keeps the message, the decoder and the encoder alive until the servant finished
+        (incoming->streamed ? completeStreamed(servant, incoming) : servant->_dispatch(request->operation, incoming->decoder, incoming->encoder))
+            .thenOrCatch(
+                [this, connection, responseExpected, requestId, incoming] {
+                    // Logger::debug("SERVANT RETURNED");
+                    if (responseExpected) {
+                        // Logger::debug("SERVANT WANTS RESPONSE");
+                        auto &encoder = incoming->encoder;
+                        encoder.setGIOPHeader(MessageType::REPLY);
+                        encoder.setReplyHeader(requestId, ReplyStatus::NO_EXCEPTION);
+                        Logger::debug("{}send REPLY via connection {}", prefix(this), connection->str());
+                        // hexdump(encoder.buffer.data(), length);
+                        connection->send(move(encoder.buffer._data));
+                    }
+                },
+                [connection, servant, responseExpected, requestId, incoming](std::exception_ptr eptr) {
+                    auto &encoder = incoming->encoder;
+                    auto &operation = incoming->header->operation;
+                    try {
+                        std::rethrow_exception(eptr);
+                    } catch (CORBA::UserException &ex) {
+                        Logger::error("CORBA::UserException while calling local servant {}::{}(...): {}", servant->repository_id(), operation,
+                                      ex.what());
+                        if (responseExpected) {
+                            encoder.setGIOPHeader(MessageType::REPLY);
+                            encoder.setReplyHeader(requestId, ReplyStatus::USER_EXCEPTION);
+                            connection->send(move(encoder.buffer._data));
+                        }
+                    } catch (CORBA::SystemException &error) {
+                        println("{} while calling local servant {}::{}(...): {}", error._rep_id(), servant->repository_id(), operation, error.what());
+                        if (responseExpected) {
+                            encoder.writeString(error._rep_id());
+                            encoder.writeUlong(error.minor);
+                            encoder.writeUlong(error.completed);
+                            encoder.setGIOPHeader(MessageType::REPLY);
+                            encoder.setReplyHeader(requestId, ReplyStatus::SYSTEM_EXCEPTION);
+                            connection->send(move(encoder.buffer._data));
+                        }
+                    } catch (std::exception &ex) {
+                        Logger::error("std::exception while calling local servant {}::{}(...): {}", servant->repository_id(), operation, ex.what());
+                        if (responseExpected) {
+                            encoder.writeString("IDL:mark13.org/CORBA/GENERIC:1.0");
+                            encoder.writeUlong(0);
+                            encoder.writeUlong(0);
+                            encoder.writeString(format("IDL:{}:1.0: {}", typeid(ex).name(), ex.what()));
+                            encoder.setGIOPHeader(MessageType::REPLY);
+                            encoder.setReplyHeader(requestId, ReplyStatus::SYSTEM_EXCEPTION);
+                            connection->send(move(encoder.buffer._data));
+                        }
+                    } catch (...) {
+                        Logger::error("SERVANT THREW EXCEPTION");
+                    }
+                });
+    } catch (std::out_of_range &e) {
+        if (responseExpected) {
+            // send reply
+        }
+        Logger::error("OUT OF RANGE: {}", e.what());
+    } catch (std::exception &e) {
+        if (responseExpected) {
+            // send reply
+        }
+        Logger::error("OUT OF EXCEPTION: {}", e.what());
+    }
+}
+
+/**
+ * the message decoded by data is only valid during ORB::socketRcvd() unless
+ * there is a holder, otherwise copy it
+ */
+static void retain(CDRDecoder &data, std::shared_ptr<const void> &holder) {
+    if (!holder) {
+        auto message = make_shared<detail::Buffer>(data._data, data._data + data.length);
+        data._data = message->data();
+        holder = move(message);
+    }
+}
+
+void ORB::streamRequest(detail::Connection *connection, uint32_t requestId, GIOPDecoder &decoder) {
+    // the request header is needed for the reply once all fragments arrived,
+    // copy the first fragment instead of holding on to the receive buffer
+    shared_ptr<const void> holder;
+    retain(decoder.buffer, holder);
+    // the first fragment might be too short to hold the whole request header
+    decoder.buffer.setOffset(sizeof(GIOPHeader));
+    unique_ptr<const RequestHeader> request;
+    try {
+        request.reset(decoder.scanRequestHeader());
+    } catch (out_of_range &) {
+        return;
+    }
+    auto servant = findServant(request->objectKey);
+    if (!servant) {
+        return;
+    }
+    auto handler = servant->_stream(request->operation);
+    if (!handler) {
+        return;
+    }
+    // the connection holds on to the callback, hence it must not hold on to the connection
+    auto message = make_shared<detail::ReceivedMessage>(decoder, move(holder));
+    connection->stream(requestId, decoder.buffer.getOffset(), std::move(handler),
+                       [this, connection, servant, message, header = *request](std::exception_ptr error) {
+                           auto incoming = make_shared<detail::IncomingRequest>(message->decoder, make_unique<const RequestHeader>(header),
+                                                                                shared_ptr<const void>(message->holder));
+                           incoming->streamed = true;
+                           incoming->error = error;
+                           schedule(connection->shared_from_this(), servant, incoming);
+                       });
+}
+
+void ORB::socketRcvd(detail::Connection *connection, const void *buffer, size_t size, std::shared_ptr<const void> holder) {
     Logger::debug("{}socketRcvd(connection={}, buffer, size={})", prefix(this), connection->str(), size);
     if (size == 0) {
         return;
     }
+    connection->touch();
     CDRDecoder data((const char *)buffer, size);
     GIOPDecoder decoder(data);
     decoder.connection = connection;
     auto type = decoder.scanGIOPHeader();
+    if (decoder.moreFragments || type == MessageType::FRAGMENT) {
+        if (decoder.majorVersion != 1 || decoder.minorVersion < 2) {
+            Logger::error("ORB::socketRcvd(): fragments are only supported with GIOP 1.2");
+            return;
+        }
+        if ((type != MessageType::FRAGMENT && maxFragmentedMessages != 0 && connection->fragmented.size() >= maxFragmentedMessages) ||
+            (maxFragmentedBytes != 0 && connection->fragmentedBytes() + size > maxFragmentedBytes)) {
+            Logger::error("{}ORB::socketRcvd(): {} exceeds the limits for fragmented messages", prefix(this), connection->str());
+            connection->fragmented.clear();
+            GIOPEncoder encoder(connection);
+            encoder.buffer.offset = 12;
+            encoder.setGIOPHeader(MessageType::MESSAGE_ERROR);
+            connection->send(move(encoder.buffer._data));
+            close(connection);
+            return;
+        }
+        // GIOP 1.2 puts the request id right after the header of the first message and the fragments
+        auto requestId = decoder.readUlong();
+        auto message = connection->reassemble(requestId, type == MessageType::FRAGMENT, decoder.moreFragments, (const char *)buffer, size);
+        if (type == MessageType::REQUEST) {
+            streamRequest(connection, requestId, decoder);
+        }
+        if (message) {
+            shared_ptr<detail::Buffer> reassembled(move(message));
+            socketRcvd(connection, reassembled->data(), reassembled->size(), reassembled);
+        }
+        return;
+    }
     switch (type) {
         case MessageType::REQUEST: {
+            // the arguments handed to the servant point into the message, which
+            // is only valid during this call unless there is a holder
+            retain(data, holder);
             // TODO: move this into a method
-            auto request = decoder.scanRequestHeader();
+            unique_ptr<const RequestHeader> request(decoder.scanRequestHeader());
             Logger::debug("REQUEST(requestId={}, objectKey={}, operation={})", request->requestId, request->objectKey, request->operation);
 
-            auto servant = servants.find(request->objectKey);  // FIXME: avoid string copy
-            if (servant == servants.end()) {
+            auto servant = findServant(request->objectKey);
+            if (!servant) {
                 Logger::error("NO SERVANT FOUND");
                 if (request->responseExpected) {
                     CORBA::GIOPEncoder encoder(connection);
@@ -382,9 +844,9 @@ void ORB::socketRcvd(detail::Connection *connection, const void *buffer, size_t
                 encoder.minorVersion = decoder.minorVersion;
                 encoder.skipReplyHeader();
 
-                auto result = (repositoryId.compare(servant->second->repository_id()) == 0);
-                Logger::debug("    want \"{}\",\n    have \"{}\" -> {}", repositoryId, servant->second->repository_id(), result);
-                encoder.writeBoolean(repositoryId == servant->second->repository_id());
+                auto result = (repositoryId.compare(servant->repository_id()) == 0);
+                Logger::debug("    want \"{}\",\n    have \"{}\" -> {}", repositoryId, servant->repository_id(), result);
+                encoder.writeBoolean(repositoryId == servant->repository_id());
 
                 auto length = encoder.buffer.offset;
                 encoder.setGIOPHeader(MessageType::REPLY);
@@ -396,90 +858,19 @@ void ORB::socketRcvd(detail::Connection *connection, const void *buffer, size_t
                 return;
             }
 
-            try {
-                auto encoder = make_shared<CORBA::GIOPEncoder>(connection);
-                encoder->majorVersion = decoder.majorVersion;
-                encoder->minorVersion = decoder.minorVersion;
-                encoder->skipReplyHeader();
-                bool responseExpected = request->responseExpected;
-                uint32_t requestId = request->requestId;
-
-                // move parts of this into a separate function so that it can be unit tested
-                // std::cerr << "CALL SERVANT" << std::endl;
-                servant->second->_dispatch(request->operation, decoder, *encoder)
-                    .thenOrCatch(
-                        [this, encoder, connection, responseExpected, requestId] {  // FIXME: the references objects won't be available
-                            // Logger::debug("SERVANT RETURNED");
-                            if (responseExpected) {
-                                // Logger::debug("SERVANT WANTS RESPONSE");
-                                auto length = encoder->buffer.offset;
-                                encoder->setGIOPHeader(MessageType::REPLY);
-                                encoder->setReplyHeader(requestId, ReplyStatus::NO_EXCEPTION);
-                                Logger::debug("{}send REPLY via connection {}", prefix(this), connection->str());
-                                // hexdump(encoder->buffer.data(), length);
-                                connection->send(move(encoder->buffer._data));
-                            }
-                        },
-                        [&](std::exception_ptr eptr) {  // FIXME: the references objects won't be available
-                            try {
-                                std::rethrow_exception(eptr);
-                            } catch (CORBA::UserException &ex) {
-                                Logger::error("CORBA::UserException while calling local servant {}::{}(...): {}", servant->second->repository_id(),
-                                              request->operation, ex.what());
-                                if (responseExpected) {
-                                    auto length = encoder->buffer.offset;
-                                    encoder->setGIOPHeader(MessageType::REPLY);
-                                    encoder->setReplyHeader(requestId, ReplyStatus::USER_EXCEPTION);
-                                    connection->send(move(encoder->buffer._data));
-                                }
-                            } catch (CORBA::SystemException &error) {
-                                println("{} while calling local servant {}::{}(...): {}", error._rep_id(), servant->second->repository_id(), request->operation,
-                                        error.what());
-                                if (responseExpected) {
-                                    encoder->writeString(error._rep_id());
-                                    encoder->writeUlong(error.minor);
-                                    encoder->writeUlong(error.completed);
-                                    auto length = encoder->buffer.offset;
-                                    encoder->setGIOPHeader(MessageType::REPLY);
-                                    encoder->setReplyHeader(requestId, ReplyStatus::SYSTEM_EXCEPTION);
-                                    connection->send(move(encoder->buffer._data));
-                                }
-                            } catch (std::exception &ex) {
-                                Logger::error("std::exception while calling local servant {}::{}(...): {}", servant->second->repository_id(),
-                                              request->operation, ex.what());
-                                if (responseExpected) {
-                                    encoder->writeString("IDL:mark13.org/CORBA/GENERIC:1.0");
-                                    encoder->writeUlong(0);
-                                    encoder->writeUlong(0);
-                                    encoder->writeString(format("IDL:{}:1.0: {}", typeid(ex).name(), ex.what()));
-                                    auto length = encoder->buffer.offset;
-                                    encoder->setGIOPHeader(MessageType::REPLY);
-                                    encoder->setReplyHeader(requestId, ReplyStatus::SYSTEM_EXCEPTION);
-                                    connection->send(move(encoder->buffer._data));
-                                }
-                            } catch (...) {
-                                Logger::error("SERVANT THREW EXCEPTION");
-                            }
-                        });
-            } catch (std::out_of_range &e) {
-                if (request->responseExpected) {
-                    // send reply
-                }
-                Logger::error("OUT OF RANGE: {}", e.what());
-            } catch (std::exception &e) {
-                if (request->responseExpected) {
-                    // send reply
-                }
-                Logger::error("OUT OF EXCEPTION: {}", e.what());
-            }
+            // everything up to here ran on the thread owning the connection,
+            // only the servant call moves to the thread selected by it's policy
+            auto incoming = make_shared<detail::IncomingRequest>(decoder, move(request), move(holder));
+            schedule(connection->shared_from_this(), servant, incoming);
         } break;
 
         case MessageType::REPLY: {
             auto _data = decoder.scanReplyHeader();
             Logger::debug("ORB::socketRcvd(): REPLY, resume requestId {}", _data->requestId);
-            try {
-                connection->interlock.resume(_data->requestId, &decoder);
-            } catch (...) {
+            // the caller might be resumed after this call returned, see RequestTable::resume()
+            retain(data, holder);
+            auto message = make_shared<detail::ReceivedMessage>(decoder, move(holder));
+            if (!connection->outstanding.resume(_data->requestId, shared_ptr<GIOPDecoder>(message, &message->decoder))) {
                 Logger::error("ORB::socketRcvd(): unexpected reply to requestId {}", _data->requestId);
             }
             break;
@@ -487,17 +878,22 @@ void ORB::socketRcvd(detail::Connection *connection, const void *buffer, size_t
 
         case MessageType::LOCATE_REQUEST: {
             auto _data = decoder.scanLocateRequest();  // actuall
-            auto servant = servants.find(_data->objectKey);
+            auto servant = findServant(_data->objectKey);
             GIOPEncoder encoder(connection);
             encoder.majorVersion = decoder.majorVersion;
             encoder.minorVersion = decoder.minorVersion;
 
-            encoder.encodeLocateReply(_data->requestId, servant != servants.end() ? LocateStatusType::OBJECT_HERE : LocateStatusType::UNKNOWN_OBJECT);
+            encoder.encodeLocateReply(_data->requestId, servant ? LocateStatusType::OBJECT_HERE : LocateStatusType::UNKNOWN_OBJECT);
             encoder.setGIOPHeader(MessageType::LOCATE_REPLY);
             connection->send(move(encoder.buffer._data));
             delete _data;
         } break;
 
+        case MessageType::CLOSE_CONNECTION:
+            // the peer closes the socket next, which fails the outstanding calls with CORBA::TRANSIENT
+            Logger::debug("{}ORB::socketRcvd(): peer closes connection {}", prefix(this), connection->str());
+            break;
+
         case MessageType::MESSAGE_ERROR: {
             Logger::error("ORB::socketRcvd(): RECEIVED MESSAGE ERROR");
         } break;
@@ -507,12 +903,20 @@ void ORB::socketRcvd(detail::Connection *connection, const void *buffer, size_t
     }
 }
 
+std::shared_ptr<Skeleton> ORB::findServant(const blob_view &objectKey) const {
+    std::shared_lock lock(servantsMutex);
+    return servants.find(objectKey);
+}
+
 void ORB::activate_object(std::shared_ptr<Skeleton> servant) { activate_object_with_id(format("OID:{:x}", ++servantIdCounter), servant); }
 
 void ORB::activate_object_with_id(const std::string &objectKey, std::shared_ptr<Skeleton> servant) {
     servant->orb = shared_from_this();
-    auto pos = servants.emplace(std::make_pair(blob(objectKey), servant));
-    servant->objectKey = std::get<0>(pos)->first;
+    {
+        std::unique_lock lock(servantsMutex);
+        servants.insert(blob_view(objectKey), servant);
+    }
+    servant->objectKey = blob(objectKey);
 }
 
 void ORB::bind(const std::string &id, std::shared_ptr<CORBA::Skeleton> const obj) {
@@ -531,11 +935,7 @@ void ORB::bind(const std::string &id, std::shared_ptr<CORBA::Skeleton> const obj
 std::shared_ptr<CORBA::Skeleton> ORB::_narrow_servant(CORBA::IOR *ref) {
     auto conn0 = connections.findByLocal(ref->host.c_str(), ref->port);
     if (conn0) {
-        auto keyImpl = conn0->protocol->orb->servants.find(ref->objectKey);
-        if (keyImpl != conn0->protocol->orb->servants.end()) {
-            return keyImpl->second;
-
-        }
+        return conn0->protocol->orb->findServant(ref->objectKey);
     }
     return {};
 }
@@ -1,13 +1,18 @@
 #pragma once
 
+#include <chrono>
 #include <functional>
 #include <map>
 #include <memory>
+#include <optional>
+#include <shared_mutex>
 #include <vector>
 
 #include "coroutine.hh"
 #include "giop.hh"
 #include "net/connection.hh"
+#include "net/threadpool.hh"
+#include "util/objectmap.hh"
 
 namespace CORBA {
 
@@ -18,6 +23,7 @@ class ORB;
 
 namespace detail {
 class Protocol;
+struct IncomingRequest;
 }
 
 /**
@@ -37,6 +43,33 @@ void installSystemExceptionHandler(std::shared_ptr<CORBA::Object> object, std::f
 // installTransientExceptionHandler
 // installCommFailureExceptionHandler
 
+/**
+ * Sets the roundtrip timeout for the twowayCalls started by the current thread
+ * while it exists, overriding the ones of the stub and the ORB
+ * (RelativeRoundtripTimeoutPolicy set on the PolicyCurrent).
+ *
+ * A call is started when the stub's method is called, hence for a single call
+ * \code
+ * co_await CORBA::withRoundtripTimeout(100ms, [&] { return backend->callLong(1); });
+ * \endcode
+ */
+class RoundtripTimeout {
+        std::optional<std::chrono::milliseconds> previous;
+
+    public:
+        RoundtripTimeout(std::chrono::milliseconds timeout);
+        ~RoundtripTimeout();
+        RoundtripTimeout(const RoundtripTimeout &) = delete;
+        RoundtripTimeout &operator=(const RoundtripTimeout &) = delete;
+        static std::optional<std::chrono::milliseconds> current();
+};
+
+template <typename F>
+auto withRoundtripTimeout(std::chrono::milliseconds timeout, F &&call) {
+    RoundtripTimeout scope(timeout);
+    return call();
+}
+
 class ORB : public std::enable_shared_from_this<ORB> {
     public:
         bool debug = false;
@@ -50,9 +83,18 @@ class ORB : public std::enable_shared_from_this<ORB> {
         /**
          * objectId to skeleton/implementation
          */
-        std::map<blob, std::shared_ptr<Skeleton>> servants;
+        detail::ObjectMap<std::shared_ptr<Skeleton>> servants;
+        // servants are looked up from the worker loops
+        mutable std::shared_mutex servantsMutex;
+        std::shared_ptr<Skeleton> findServant(const blob_view &objectKey) const;
+        /**
+         * let the servant stream the arguments of a fragmented request, see Skeleton::_stream()
+         */
+        void streamRequest(detail::Connection *connection, uint32_t requestId, GIOPDecoder &decoder);
+        void schedule(std::shared_ptr<detail::Connection> connection, std::shared_ptr<Skeleton> servant, std::shared_ptr<detail::IncomingRequest> incoming);
+        void dispatch(std::shared_ptr<detail::Connection> connection, std::shared_ptr<Skeleton> servant, std::shared_ptr<detail::IncomingRequest> incoming);
 
-        uint64_t servantIdCounter = 0;
+        std::atomic_uint64_t servantIdCounter = 0;
 
         std::vector<detail::Protocol *> protocols;
 
@@ -62,12 +104,60 @@ class ORB : public std::enable_shared_from_this<ORB> {
         void shutdown();
 
         detail::ConnectionPool connections;
+        /**
+         * runs the servants which are not ThreadPolicy::SINGLE_THREAD
+         */
+        detail::ThreadPool threadPool;
+        /**
+         * maximum time a twowayCall waits for the reply before it throws
+         * CORBA::TIMEOUT, 0 to wait forever
+         */
+        std::chrono::milliseconds roundtripTimeout{0};
+        /**
+         * number of connections opened to a peer for regular calls, calls go to
+         * the one with the least outstanding calls
+         */
+        size_t connectionsPerPeer = 1;
+        /**
+         * calls whose requests are estimated to take at least this many bytes
+         * use a separate connection to the peer, 0 to disable
+         *
+         * the estimate is the stub's size hint or, without one, the size of
+         * the operation's previous request
+         *
+         * see also Stub::bulk
+         */
+        size_t bulkThreshold = 0;
+        /**
+         * a connection holds at most this many GIOP 1.2 messages whose
+         * fragments are still arriving and this many bytes for them, 0 for
+         * no limit. a peer exceeding them gets a MessageError and the
+         * connection is closed.
+         *
+         * fragments already read by a servant's _stream() handler are not
+         * counted, hence streamed requests may be larger
+         */
+        size_t maxFragmentedMessages = 64;
+        size_t maxFragmentedBytes = 256 * 1024 * 1024;
 
         void registerProtocol(detail::Protocol *protocol);
         std::shared_ptr<detail::Connection> getConnection(std::string host, uint16_t port);
         // void addConnection(detail::Connection *connection) { connections.push_back(connection); }
-        void socketRcvd(detail::Connection *connection, const void *buffer, size_t size);
+        /**
+         * handle a GIOP message received by connection
+         *
+         * \param holder keeps buffer valid after the call. a request holds on
+         *        to it until the servant's _dispatch() finished so that the
+         *        string_view, blob_view and span arguments stay valid across
+         *        co_await. without it the message is copied before being dispatched.
+         */
+        void socketRcvd(detail::Connection *connection, const void *buffer, size_t size, std::shared_ptr<const void> holder = {});
+        /**
+         * send GIOP CloseConnection and close the connection, it is dropped
+         * from the connection pool unless stubs still use it
+         */
         void close(detail::Connection *connection);
+        std::shared_ptr<detail::Connection> connectionFor(Stub *stub, size_t sizeHint, bool oneway = false);
 
         /**
          * Returns an object for the provided CORBA URI.
@@ -88,22 +178,25 @@ class ORB : public std::enable_shared_from_this<ORB> {
          * \param operation name of the operation (aka. function/method name)
          * \param encode callback encoding the outgoing arguments
          * \param decode callback decoding the incoming arguments
+         * \param sizeHint expected size of the encoded arguments, used to allocate the request buffer upfront,
+         *        0 to estimate it from the size of the operation's previous request
          */
         template <typename T>
-        async<T> twowayCall(Stub *stub, const char *operation, std::function<void(GIOPEncoder &)> encode, std::function<T(GIOPDecoder &)> decode) {
-            auto decoder = co_await _twowayCall(stub, operation, encode);
+        async<T> twowayCall(Stub *stub, const char *operation, std::function<void(GIOPEncoder &)> encode, std::function<T(GIOPDecoder &)> decode,
+                            size_t sizeHint = 0) {
+            auto decoder = co_await _twowayCall(stub, operation, encode, sizeHint);
             co_return decode(*decoder);
         }
 
-        async<void> twowayCall(Stub *stub, const char *operation, std::function<void(GIOPEncoder &)> encode) {
-            co_await _twowayCall(stub, operation, encode);
+        async<void> twowayCall(Stub *stub, const char *operation, std::function<void(GIOPEncoder &)> encode, size_t sizeHint = 0) {
+            co_await _twowayCall(stub, operation, encode, sizeHint);
             co_return;
         }
 
         /**
          * call the peer without waiting for a response (oneway)
          */
-        void onewayCall(Stub *stub, const char *operation, std::function<void(GIOPEncoder &)> encode);
+        void onewayCall(Stub *stub, const char *operation, std::function<void(GIOPEncoder &)> encode, size_t sizeHint = 0);
 
         //
         // NameService
@@ -120,7 +213,8 @@ class ORB : public std::enable_shared_from_this<ORB> {
         std::shared_ptr<CORBA::Skeleton> _narrow_servant(CORBA::IOR *ref);
 
     protected:
-        async<GIOPDecoder *> _twowayCall(Stub *stub, const char *operation, std::function<void(GIOPEncoder &)> encode);
+        std::shared_ptr<detail::Connection> connectionForLane(const std::shared_ptr<detail::Connection> &primary, bool bulk);
+        async<std::shared_ptr<GIOPDecoder>> _twowayCall(Stub *stub, const char *operation, std::function<void(GIOPEncoder &)> encode, size_t sizeHint);
 };
 
 }  // namespace CORBA
@@ -1,12 +1,35 @@
 #pragma once
 
+#include <functional>
+
 #include "object.hh"
 #include "coroutine.hh"
+#include "util/operationtable.hh"
 
 namespace CORBA {
 
 class GIOPDecoder;
 class GIOPEncoder;
+class CDRStreamDecoder;
+
+/**
+ * where the ORB runs a servant's operations
+ */
+enum class ThreadPolicy {
+    /**
+     * on the event loop which received the request
+     */
+    SINGLE_THREAD,
+    /**
+     * on any thread of ORB::threadPool, concurrently
+     */
+    THREAD_POOL,
+    /**
+     * on a thread of ORB::threadPool, one at a time and in order for requests
+     * arriving on the same connection
+     */
+    PER_CONNECTION_SERIAL
+};
 
 /**
  * Base class for representing object implementations.
@@ -16,6 +39,24 @@ class Skeleton : public virtual Object, public std::enable_shared_from_this<Skel
         friend class ORB;
         std::shared_ptr<CORBA::ORB> orb;
         blob objectKey;
+        /**
+         * When the ORB runs more than one event loop, requests for a loop-local
+         * servant are dispatched right away on the loop owning the connection
+         * they arrived on. Such a servant must not share mutable state between
+         * loops without synchronizing it itself.
+         *
+         * Requests for other servants are handed to the ORB's home loop.
+         */
+        bool loopLocal = false;
+        /**
+         * Servants doing CPU heavy work should not run on the event loop
+         * because they stall all the other connections meanwhile.
+         *
+         * Operations running on the ORB's thread pool may make twoway calls,
+         * the request is sent by the thread owning the connection and the
+         * operation continues on it's pool thread once the reply arrived.
+         */
+        ThreadPolicy threadPolicy = ThreadPolicy::SINGLE_THREAD;
 
     // public:
         Skeleton() {}
@@ -25,6 +66,24 @@ class Skeleton : public virtual Object, public std::enable_shared_from_this<Skel
         virtual blob_view get_object_key() const override { return objectKey; }
         std::shared_ptr<CORBA::ORB> get_ORB() const override { return orb; }
         virtual CORBA::async<> _dispatch(const std::string_view &operation, GIOPDecoder &decoder, GIOPEncoder &encoder) = 0;
+        /**
+         * Called when a request arrives as GIOP 1.2 fragments. A servant
+         * returning a handler gets the operation's arguments passed while the
+         * fragments are still arriving, e.g. to process a large sequence with
+         * a SequenceReader before the last byte was received.
+         *
+         * The handler runs on the loop receiving the request and is called a
+         * last time with last = true. The fragments are freed once the handler
+         * has read them, hence the request is completed by _streamed() instead
+         * of _dispatch().
+         */
+        virtual std::function<void(CDRStreamDecoder &arguments, bool last)> _stream(const std::string_view &operation) { return {}; }
+        /**
+         * Called instead of _dispatch() once the handler returned by _stream()
+         * got the last fragment, on the thread selected by threadPolicy. Writes
+         * the operation's results, the default has none.
+         */
+        virtual CORBA::async<> _streamed(const std::string_view &operation, GIOPEncoder &encoder) { co_return; }
 };
 
 }  // namespace CORBA
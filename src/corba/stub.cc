@@ -2,6 +2,7 @@
 #include "orb.hh"
 #include "net/protocol.hh"
 
+#include <cstring>
 #include <print>
 
 using namespace std;
@@ -10,6 +11,22 @@ namespace CORBA {
 
 // IT IS TIME TO START WRITING A FREAKING BUNCH OF UNIT TESTS!!!
 
+Stub::RequestSize Stub::lastRequestSize(const char *operation) {
+    auto &slot = requestSizeSlot(operation);
+    auto name = slot.operation.load(memory_order_relaxed);
+    if (name != operation && (name == nullptr || strcmp(name, operation) != 0)) {
+        return {};
+    }
+    return {slot.length.load(memory_order_relaxed), slot.size.load(memory_order_relaxed)};
+}
+
+void Stub::lastRequestSize(const char *operation, const RequestSize &size) {
+    auto &slot = requestSizeSlot(operation);
+    slot.operation.store(operation, memory_order_relaxed);
+    slot.length.store(size.length, memory_order_relaxed);
+    slot.size.store(size.size, memory_order_relaxed);
+}
+
 Stub::~Stub() {
     // println("Stub::~Stub()");
     // orb->dump();
@@ -1,5 +1,13 @@
 #pragma once
 
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+
 #include "object.hh"
 
 namespace CORBA {
@@ -18,11 +26,44 @@ class Stub : public virtual Object {
          * objectKey used on the remote end of the connection
          */
         blob objectKey;
+        /**
+         * the sizes of the last requests, in the slot picked by the hash of
+         * the operation's name. it's only an estimate, hence operations
+         * sharing a slot or concurrent calls overwriting it do no harm.
+         */
+        struct RequestSizeSlot {
+                std::atomic<const char *> operation = nullptr;
+                std::atomic_size_t length = 0;
+                std::atomic_size_t size = 0;
+        };
+        std::array<RequestSizeSlot, 8> requestSizes;
+        RequestSizeSlot &requestSizeSlot(const char *operation) { return requestSizes[std::hash<std::string_view>{}(operation) % requestSizes.size()]; }
+        /**
+         * once the stub sent a oneway call, all its calls use this connection
+         * so that they are not overtaken by later calls over another one
+         */
+        std::weak_ptr<detail::Connection> lane;
+        /**
+         * guards lane
+         */
+        std::mutex mutex;
+
     public:
         /**
          * connection to where the remote object lives
          */
         std::shared_ptr<detail::Connection> connection; 
+        /**
+         * maximum time a twowayCall waits for the reply before it throws
+         * CORBA::TIMEOUT, 0 to use the ORB's roundtripTimeout
+         * (RelativeRoundtripTimeoutPolicy set on the object reference)
+         */
+        std::chrono::milliseconds roundtripTimeout{0};
+        /**
+         * send the calls over a connection of their own, e.g. for an object
+         * returning large replies
+         */
+        bool bulk = false;
 
     public:
         void initStub(std::shared_ptr<CORBA::ORB> anOrb, const CORBA::blob_view &anObjectKey, std::shared_ptr<detail::Connection> aConnection) {
@@ -31,6 +72,26 @@ class Stub : public virtual Object {
             this->connection = aConnection;
         }
         virtual ~Stub() override;
+        struct RequestSize {
+                /**
+                 * bytes encoded into the request's buffer
+                 */
+                size_t length = 0;
+                /**
+                 * length plus the caller's memory referenced by the request,
+                 * see CDREncoder::writeBlobView()
+                 */
+                size_t size = 0;
+        };
+        /**
+         * sizes of the last request of operation, 0 when there was none yet
+         *
+         * the ORB uses them to estimate the size of the next request when the
+         * stub does not provide a size hint. operation must outlive the stub,
+         * e.g. be a string literal.
+         */
+        RequestSize lastRequestSize(const char *operation);
+        void lastRequestSize(const char *operation, const RequestSize &size);
         virtual blob_view get_object_key() const override { return objectKey; }
         std::shared_ptr<CORBA::ORB> get_ORB() const override { return orb; }
 };
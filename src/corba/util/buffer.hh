@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace CORBA {
+
+namespace detail {
+
+/**
+ * An allocator which default initializes instead of value initializing, so
+ * that resize() does not zero bytes which are overwritten right afterwards.
+ */
+template <typename T, typename A = std::allocator<T>>
+class default_init_allocator : public A {
+        using traits = std::allocator_traits<A>;
+
+    public:
+        template <typename U>
+        struct rebind {
+                using other = default_init_allocator<U, typename traits::template rebind_alloc<U>>;
+        };
+
+        using A::A;
+
+        template <typename U>
+        void construct(U *ptr) noexcept(std::is_nothrow_default_constructible<U>::value) {
+            ::new (static_cast<void *>(ptr)) U;
+        }
+        template <typename U, typename... Args>
+        void construct(U *ptr, Args &&...args) {
+            traits::construct(static_cast<A &>(*this), ptr, std::forward<Args>(args)...);
+        }
+};
+
+/**
+ * buffer holding an encoded GIOP message
+ */
+using Buffer = std::vector<char, default_init_allocator<char>>;
+
+/**
+ * caller owned memory which is to be send as part of a message without
+ * copying it into the message's Buffer
+ */
+struct BufferSegment {
+        /**
+         * offset within the Buffer at which the segment is to be inserted
+         */
+        size_t position;
+        const char *data;
+        size_t size;
+};
+
+}  // namespace detail
+}  // namespace CORBA
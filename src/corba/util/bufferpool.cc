@@ -0,0 +1,35 @@
+#include "bufferpool.hh"
+
+namespace CORBA {
+
+namespace detail {
+
+std::unique_ptr<Buffer> BufferPool::acquire() {
+    if (freeList.empty()) {
+        ++_stats.misses;
+        return std::make_unique<Buffer>();
+    }
+    ++_stats.hits;
+    auto buffer = std::move(freeList.back());
+    freeList.pop_back();
+    return buffer;
+}
+
+void BufferPool::release(std::unique_ptr<Buffer> &&buffer) {
+    if (!buffer) {
+        return;
+    }
+    if (freeList.size() >= maxBuffers || buffer->capacity() > maxBufferCapacity) {
+        ++_stats.discarded;
+        buffer.reset();
+        return;
+    }
+    buffer->clear();
+    freeList.push_back(std::move(buffer));
+    ++_stats.returned;
+}
+
+void BufferPool::clear() { freeList.clear(); }
+
+}  // namespace detail
+}  // namespace CORBA
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "buffer.hh"
+
+namespace CORBA {
+
+namespace detail {
+
+struct BufferPoolStats {
+        /** acquire() was served from the pool */
+        size_t hits = 0;
+        /** acquire() had to allocate a new buffer */
+        size_t misses = 0;
+        /** buffers which have been given back via release() and were kept */
+        size_t returned = 0;
+        /** buffers which have been given back via release() but were freed (pool full or buffer too large) */
+        size_t discarded = 0;
+};
+
+/**
+ * A free list of send buffers.
+ *
+ * CDREncoder draws it's buffer from the pool and the connection gives it back
+ * once it has been completely written to the peer. The buffers keep their
+ * capacity so that the next message of similar size is encoded without
+ * another malloc/realloc chain.
+ *
+ * The pool is not thread safe, it's meant to be owned by a connection.
+ */
+class BufferPool {
+        std::vector<std::unique_ptr<Buffer>> freeList;
+        BufferPoolStats _stats;
+
+    public:
+        /**
+         * maximal number of buffers kept in the pool
+         */
+        size_t maxBuffers = 16;
+        /**
+         * buffers with a larger capacity are freed instead of being kept in the pool
+         */
+        size_t maxBufferCapacity = 0x100000;
+
+        /**
+         * get an empty buffer, either from the pool or a newly allocated one
+         */
+        std::unique_ptr<Buffer> acquire();
+        /**
+         * give a buffer back to the pool
+         */
+        void release(std::unique_ptr<Buffer> &&buffer);
+
+        inline const BufferPoolStats &stats() const { return _stats; }
+        inline size_t size() const { return freeList.size(); }
+        void clear();
+};
+
+}  // namespace detail
+}  // namespace CORBA
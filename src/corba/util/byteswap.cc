@@ -0,0 +1,117 @@
+#include "byteswap.hh"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CORBA_BYTESWAP_X86 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define CORBA_BYTESWAP_NEON 1
+#endif
+
+namespace CORBA {
+
+namespace detail {
+
+/**
+ * pshufb masks reversing the bytes of each 2, 4 and 8 byte value within 16 bytes
+ */
+alignas(16) static const uint8_t reverse16[16] = {1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14};
+alignas(16) static const uint8_t reverse32[16] = {3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12};
+alignas(16) static const uint8_t reverse64[16] = {7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8};
+
+#ifdef CORBA_BYTESWAP_X86
+
+/**
+ * swap as many bytes as fit into whole vectors
+ *
+ * \return number of bytes swapped
+ */
+using Kernel = size_t (*)(char *destination, const char *source, size_t nbytes, const uint8_t *mask);
+
+__attribute__((target("avx2"))) static size_t swapAVX2(char *destination, const char *source, size_t nbytes, const uint8_t *mask) {
+    // vpshufb shuffles within each 128 bit lane, hence the same mask for both
+    auto m = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i *>(mask)));
+    size_t i = 0;
+    for (; i + 64 <= nbytes; i += 64) {
+        auto a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(source + i));
+        auto b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(source + i + 32));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(destination + i), _mm256_shuffle_epi8(a, m));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(destination + i + 32), _mm256_shuffle_epi8(b, m));
+    }
+    for (; i + 32 <= nbytes; i += 32) {
+        auto a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(source + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(destination + i), _mm256_shuffle_epi8(a, m));
+    }
+    return i;
+}
+
+__attribute__((target("ssse3"))) static size_t swapSSSE3(char *destination, const char *source, size_t nbytes, const uint8_t *mask) {
+    auto m = _mm_load_si128(reinterpret_cast<const __m128i *>(mask));
+    size_t i = 0;
+    for (; i + 16 <= nbytes; i += 16) {
+        auto a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(source + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(destination + i), _mm_shuffle_epi8(a, m));
+    }
+    return i;
+}
+
+static Kernel selectKernel() {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return swapAVX2;
+    }
+    if (__builtin_cpu_supports("ssse3")) {
+        return swapSSSE3;
+    }
+    return nullptr;
+}
+
+static size_t swapVector(char *destination, const char *source, size_t nbytes, const uint8_t *mask) {
+    static const Kernel kernel = selectKernel();
+    return kernel ? kernel(destination, source, nbytes, mask) : 0;
+}
+
+#elif defined(CORBA_BYTESWAP_NEON)
+
+static size_t swapVector(char *destination, const char *source, size_t nbytes, const uint8_t *mask) {
+    size_t i = 0;
+    for (; i + 16 <= nbytes; i += 16) {
+        auto a = vld1q_u8(reinterpret_cast<const uint8_t *>(source + i));
+        if (mask == reverse16) {
+            a = vrev16q_u8(a);
+        } else if (mask == reverse32) {
+            a = vrev32q_u8(a);
+        } else {
+            a = vrev64q_u8(a);
+        }
+        vst1q_u8(reinterpret_cast<uint8_t *>(destination + i), a);
+    }
+    return i;
+}
+
+#else
+
+static size_t swapVector(char *, const char *, size_t, const uint8_t *) { return 0; }
+
+#endif
+
+template <typename T>
+static void swap(void *destination, const void *source, size_t count, const uint8_t *mask) {
+    auto out = static_cast<char *>(destination);
+    auto in = static_cast<const char *>(source);
+    size_t nbytes = count * sizeof(T);
+    // what's left over by the vector loop is done one value at a time
+    for (size_t i = swapVector(out, in, nbytes, mask); i < nbytes; i += sizeof(T)) {
+        T value;
+        memcpy(&value, in + i, sizeof(T));
+        value = std::byteswap(value);
+        memcpy(out + i, &value, sizeof(T));
+    }
+}
+
+void byteswap16(void *destination, const void *source, size_t count) { swap<uint16_t>(destination, source, count, reverse16); }
+void byteswap32(void *destination, const void *source, size_t count) { swap<uint32_t>(destination, source, count, reverse32); }
+void byteswap64(void *destination, const void *source, size_t count) { swap<uint64_t>(destination, source, count, reverse64); }
+
+}  // namespace detail
+}  // namespace CORBA
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+namespace CORBA {
+
+namespace detail {
+
+template <typename T>
+inline T byteswapValue(T value) {
+    if constexpr (std::is_integral_v<T> && sizeof(T) > 1) {
+        return std::byteswap(value);
+    } else if constexpr (std::is_same_v<T, float>) {
+        return std::bit_cast<float>(std::byteswap(std::bit_cast<uint32_t>(value)));
+    } else if constexpr (std::is_same_v<T, double>) {
+        return std::bit_cast<double>(std::byteswap(std::bit_cast<uint64_t>(value)));
+    } else {
+        return value;
+    }
+}
+
+/**
+ * Copy count 16, 32 or 64 bit values from source to destination while
+ * reversing the byte order of each, e.g. to decode a sequence send by a peer
+ * of the other endianness.
+ *
+ * Uses AVX2 or SSSE3 on x86 when the CPU supports it and NEON on ARM.
+ * Neither pointer needs to be aligned, source and destination may be the same
+ * for swapping in place but must not overlap otherwise.
+ */
+void byteswap16(void *destination, const void *source, size_t count);
+void byteswap32(void *destination, const void *source, size_t count);
+void byteswap64(void *destination, const void *source, size_t count);
+
+template <typename T>
+inline void byteswap(T *destination, const void *source, size_t count) {
+    if constexpr (sizeof(T) == 2) {
+        byteswap16(destination, source, count);
+    } else if constexpr (sizeof(T) == 4) {
+        byteswap32(destination, source, count);
+    } else if constexpr (sizeof(T) == 8) {
+        byteswap64(destination, source, count);
+    } else {
+        static_assert(sizeof(T) == 1, "byteswap() supports 8, 16, 32 and 64 bit values");
+        if (destination != source) {
+            std::memmove(destination, source, count);
+        }
+    }
+}
+
+}  // namespace detail
+}  // namespace CORBA
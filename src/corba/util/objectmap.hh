@@ -0,0 +1,187 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string_view>
+#include <vector>
+
+#include "../blob.hh"
+
+namespace CORBA {
+
+namespace detail {
+
+/**
+ * The ORB's active object map: objectKey to servant.
+ *
+ * An open addressing hash table (linear probing, power of two capacity) which
+ * is looked up with the blob_view pointing into the received request, so no
+ * key is copied per request.
+ *
+ * ORB::activate_object() creates keys of the form "OID:<hex counter>". These
+ * are decoded and stored in a dense vector indexed by the counter instead.
+ */
+template <typename T>
+class ObjectMap {
+        enum class SlotState : uint8_t { EMPTY, USED, DELETED };
+        struct Slot {
+                size_t hash = 0;
+                blob key;
+                T value;
+                SlotState state = SlotState::EMPTY;
+        };
+        std::vector<Slot> slots;
+        size_t used = 0;
+        size_t deleted = 0;
+
+        std::vector<T> dense;
+        size_t denseUsed = 0;
+
+    public:
+        /**
+         * the counter of an "OID:<hex counter>" key as created by
+         * ORB::activate_object() or 0 for any other key
+         */
+        static uint64_t oid(const blob_view &key) {
+            if (key.size() <= 4 || key.size() > 4 + 16 || key.substr(0, 4) != u8"OID:" || key[4] == '0') {
+                return 0;
+            }
+            uint64_t counter = 0;
+            for (size_t i = 4; i < key.size(); ++i) {
+                auto c = key[i];
+                if (c >= '0' && c <= '9') {
+                    counter = (counter << 4) | (c - '0');
+                } else if (c >= 'a' && c <= 'f') {
+                    counter = (counter << 4) | (c - 'a' + 10);
+                } else {
+                    return 0;
+                }
+            }
+            return counter;
+        }
+
+        /**
+         * the servant registered for key or an empty value
+         */
+        T find(const blob_view &key) const {
+            auto counter = oid(key);
+            if (counter != 0 && counter < dense.size() && dense[counter]) {
+                return dense[counter];
+            }
+            if (used == 0) {
+                return {};
+            }
+            auto hash = hashOf(key);
+            auto mask = slots.size() - 1;
+            for (auto idx = hash & mask;; idx = (idx + 1) & mask) {
+                auto &slot = slots[idx];
+                if (slot.state == SlotState::EMPTY) {
+                    return {};
+                }
+                if (slot.state == SlotState::USED && slot.hash == hash && blob_view(slot.key) == key) {
+                    return slot.value;
+                }
+            }
+        }
+
+        /**
+         * register value for key, does nothing and returns false when key is already in use
+         */
+        bool insert(const blob_view &key, const T &value) {
+            if (find(key)) {
+                return false;
+            }
+            auto counter = oid(key);
+            // keep the vector dense, keys far beyond the counters in use go into the hash table
+            if (counter != 0 && counter < 2 * dense.size() + 1024) {
+                if (counter >= dense.size()) {
+                    dense.resize(std::max(counter + 1, 2 * dense.size()));
+                }
+                dense[counter] = value;
+                ++denseUsed;
+                return true;
+            }
+            if ((used + deleted + 1) * 4 > slots.size() * 3) {
+                rehash(std::max(size_t(16), std::bit_ceil((used + 1) * 2)));
+            }
+            auto hash = hashOf(key);
+            auto mask = slots.size() - 1;
+            auto idx = hash & mask;
+            while (slots[idx].state == SlotState::USED) {
+                idx = (idx + 1) & mask;
+            }
+            auto &slot = slots[idx];
+            if (slot.state == SlotState::DELETED) {
+                --deleted;
+            }
+            slot.hash = hash;
+            slot.key = blob(key);
+            slot.value = value;
+            slot.state = SlotState::USED;
+            ++used;
+            return true;
+        }
+
+        bool erase(const blob_view &key) {
+            auto counter = oid(key);
+            if (counter != 0 && counter < dense.size() && dense[counter]) {
+                dense[counter] = {};
+                --denseUsed;
+                return true;
+            }
+            if (used == 0) {
+                return false;
+            }
+            auto hash = hashOf(key);
+            auto mask = slots.size() - 1;
+            for (auto idx = hash & mask;; idx = (idx + 1) & mask) {
+                auto &slot = slots[idx];
+                if (slot.state == SlotState::EMPTY) {
+                    return false;
+                }
+                if (slot.state == SlotState::USED && slot.hash == hash && blob_view(slot.key) == key) {
+                    slot.key.clear();
+                    slot.value = {};
+                    slot.state = SlotState::DELETED;
+                    --used;
+                    ++deleted;
+                    return true;
+                }
+            }
+        }
+
+        inline size_t size() const { return used + denseUsed; }
+        inline bool empty() const { return size() == 0; }
+
+        void clear() {
+            slots.clear();
+            dense.clear();
+            used = deleted = denseUsed = 0;
+        }
+
+    private:
+        static inline size_t hashOf(const blob_view &key) { return std::hash<std::u8string_view>{}(key); }
+
+        void rehash(size_t capacity) {
+            std::vector<Slot> old(capacity);
+            old.swap(slots);
+            auto mask = slots.size() - 1;
+            for (auto &slot : old) {
+                if (slot.state != SlotState::USED) {
+                    continue;
+                }
+                auto idx = slot.hash & mask;
+                while (slots[idx].state == SlotState::USED) {
+                    idx = (idx + 1) & mask;
+                }
+                slots[idx] = std::move(slot);
+            }
+            deleted = 0;
+        }
+};
+
+}  // namespace detail
+}  // namespace CORBA
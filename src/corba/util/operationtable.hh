@@ -0,0 +1,156 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string_view>
+
+namespace CORBA {
+
+namespace detail {
+
+/**
+ * A minimal perfect hash over the operation names of an interface, computed
+ * at compile time, so that Skeleton::_dispatch() does a single hash and a
+ * single string compare instead of a chain of string compares:
+ *
+ *   static constexpr detail::OperationTable _operations({"resolve", "resolve_str"});
+ *   switch (_operations.find(operation)) {
+ *       case 0: ... // resolve
+ *       case 1: ... // resolve_str
+ *       default: // bad operation
+ *   }
+ *
+ * find() returns the index of the operation in the list given to the
+ * constructor or -1.
+ *
+ * The names are hashed into buckets and each bucket gets a displacement which
+ * moves it's names to free slots in a table of twice the size (hash and
+ * displace).
+ */
+template <size_t N>
+class OperationTable {
+        static constexpr size_t buckets = std::bit_ceil(N);
+        static constexpr size_t slots = 2 * buckets;
+        static constexpr uint16_t empty = 0xffff;
+        static_assert(N < empty, "too many operations");
+
+        std::array<std::string_view, N> names;
+        std::array<uint16_t, buckets> displacement;
+        std::array<uint16_t, slots> table;
+        uint64_t seed = 0;
+
+    public:
+        consteval OperationTable(const std::string_view (&operations)[N]) : names(), displacement(), table() {
+            for (size_t i = 0; i < N; ++i) {
+                names[i] = operations[i];
+                for (size_t j = 0; j < i; ++j) {
+                    if (names[i] == names[j]) {
+                        throw std::logic_error("duplicate operation name");
+                    }
+                }
+            }
+            for (seed = 0; seed < 1024; ++seed) {
+                if (build()) {
+                    return;
+                }
+            }
+            throw std::logic_error("failed to find a perfect hash");
+        }
+
+        constexpr int find(const std::string_view &operation) const {
+            auto h = hash(seed, operation);
+            auto index = table[(h + displacement[bucketOf(h)]) & (slots - 1)];
+            if (index != empty && names[index] == operation) {
+                return index;
+            }
+            return -1;
+        }
+
+        constexpr size_t size() const { return N; }
+        constexpr const std::string_view &operator[](size_t index) const { return names[index]; }
+
+        /**
+         * FNV-1a followed by the MurmurHash3 finalizer, so that names which only
+         * differ in their last character spread over all bits
+         */
+        static constexpr uint64_t hash(uint64_t seed, const std::string_view &value) {
+            uint64_t h = 0xcbf29ce484222325ull ^ (seed * 0x9e3779b97f4a7c15ull);
+            for (auto c : value) {
+                h ^= static_cast<uint8_t>(c);
+                h *= 0x100000001b3ull;
+            }
+            h ^= h >> 33;
+            h *= 0xff51afd7ed558ccdull;
+            h ^= h >> 33;
+            h *= 0xc4ceb9fe1a85ec53ull;
+            return h ^ (h >> 33);
+        }
+
+    private:
+        constexpr bool build() {
+            // sort the names by bucket
+            std::array<uint64_t, N> hashes{};
+            std::array<size_t, buckets + 1> start{};
+            for (size_t i = 0; i < N; ++i) {
+                hashes[i] = hash(seed, names[i]);
+                ++start[bucketOf(hashes[i]) + 1];
+            }
+            for (size_t b = 0; b < buckets; ++b) {
+                start[b + 1] += start[b];
+            }
+            std::array<uint16_t, N> members{};
+            auto next = start;
+            for (size_t i = 0; i < N; ++i) {
+                members[next[bucketOf(hashes[i])]++] = i;
+            }
+
+            table.fill(empty);
+            displacement.fill(0);
+
+            // place the largest buckets first while the table is still empty
+            size_t largest = 0;
+            for (size_t b = 0; b < buckets; ++b) {
+                largest = std::max(largest, start[b + 1] - start[b]);
+            }
+            for (size_t count = largest; count > 0; --count) {
+                for (size_t b = 0; b < buckets; ++b) {
+                    if (start[b + 1] - start[b] == count && !place(b, hashes, members.data() + start[b], members.data() + start[b + 1])) {
+                        return false;
+                    }
+                }
+            }
+            return true;
+        }
+
+        constexpr bool place(size_t bucket, const std::array<uint64_t, N> &hashes, const uint16_t *begin, const uint16_t *end) {
+            for (size_t d = 0; d < slots; ++d) {
+                auto member = begin;
+                for (; member != end; ++member) {
+                    auto slot = (hashes[*member] + d) & (slots - 1);
+                    if (table[slot] != empty) {
+                        break;
+                    }
+                    table[slot] = *member;
+                }
+                if (member == end) {
+                    displacement[bucket] = d;
+                    return true;
+                }
+                // undo the partial placement
+                while (member != begin) {
+                    --member;
+                    table[(hashes[*member] + d) & (slots - 1)] = empty;
+                }
+            }
+            return false;
+        }
+
+        static constexpr size_t bucketOf(uint64_t hash) { return (hash >> 32) & (buckets - 1); }
+};
+
+}  // namespace detail
+}  // namespace CORBA
@@ -0,0 +1,217 @@
+#pragma once
+
+#include <atomic>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+namespace CORBA {
+
+namespace detail {
+
+/**
+ * Resumes coroutines one after the other instead of nesting them.
+ *
+ * A coroutine resumed with a reply might make another call whose reply, e.g.
+ * from a peer within the same process, resumes the next coroutine before the
+ * first one returned, and so on without bound. While a coroutine is being
+ * resumed on the calling thread, resume() only queues the next one, which the
+ * outermost resume() runs once the current one suspended or finished.
+ */
+class ResumeQueue {
+        static inline thread_local bool running = false;
+        static inline thread_local std::vector<std::coroutine_handle<>> queue;
+
+    public:
+        static void resume(std::coroutine_handle<> handle) {
+            if (running) {
+                queue.push_back(handle);
+                return;
+            }
+            running = true;
+            handle.resume();
+            // resuming may queue more, hence no range-based for loop
+            for (size_t i = 0; i < queue.size(); ++i) {
+                queue[i].resume();
+            }
+            queue.clear();
+            running = false;
+        }
+};
+
+/**
+ * The requests a connection awaits a reply for: requestId to the suspended
+ * coroutine.
+ *
+ * The ids of outgoing requests increase by 2, so a ring of N slots indexed by
+ * (requestId >> 1) % N is used like an array and neither suspend() nor
+ * resume() allocates. Each slot is tagged with the full request id, hence a
+ * late reply is not mistaken for the one to the newer request now using the
+ * slot. When more than N requests are outstanding and a slot is still taken,
+ * the request goes into an overflow map instead.
+ *
+ * The suspended coroutine's awaiter lives in the coroutine frame and a slot
+ * just points to it. A slot is claimed by compare-and-swap on it's tag, so
+ * that of e.g. a reply and a timeout only one resumes the coroutine.
+ */
+template <typename V, size_t N = 256>
+class RequestTable {
+        static_assert((N & (N - 1)) == 0, "N must be a power of two");
+
+        struct Awaiter;
+        /**
+         * tag of an unused slot
+         */
+        static constexpr uint64_t FREE = 0;
+        /**
+         * tag of a slot being filled or resumed
+         */
+        static constexpr uint64_t CLAIMED = 1;
+        static constexpr uint64_t tagOf(uint32_t requestId) { return (uint64_t(requestId) + 1) << 1; }
+
+        struct Slot {
+                std::atomic_uint64_t tag = FREE;
+                Awaiter *awaiter = nullptr;
+        };
+        std::vector<Slot> ring = std::vector<Slot>(N);
+
+        std::mutex mutex;
+        std::map<uint32_t, Awaiter *> overflow;
+
+        std::atomic_size_t outstanding = 0;
+        std::atomic_size_t overflowed = 0;
+
+        struct Awaiter {
+                RequestTable *table;
+                uint32_t requestId;
+                std::function<void(std::coroutine_handle<>)> schedule;
+                std::function<void()> suspended;
+                std::coroutine_handle<> handle;
+                std::optional<V> value;
+
+                bool await_ready() const noexcept { return false; }
+                void await_suspend(std::coroutine_handle<> handle) {
+                    this->handle = handle;
+                    // once inserted, another thread may resume the coroutine
+                    auto then = std::move(suspended);
+                    table->insert(this);
+                    if (then) {
+                        then();
+                    }
+                }
+                V await_resume() { return std::move(*value); }
+        };
+
+        void insert(Awaiter *awaiter) {
+            ++outstanding;
+            auto &slot = ring[(awaiter->requestId >> 1) & (N - 1)];
+            uint64_t expected = FREE;
+            if (slot.tag.compare_exchange_strong(expected, CLAIMED, std::memory_order_acquire)) {
+                slot.awaiter = awaiter;
+                slot.tag.store(tagOf(awaiter->requestId), std::memory_order_release);
+                return;
+            }
+            ++overflowed;
+            std::lock_guard lock(mutex);
+            overflow[awaiter->requestId] = awaiter;
+        }
+
+        Awaiter *remove(uint32_t requestId) {
+            auto &slot = ring[(requestId >> 1) & (N - 1)];
+            uint64_t expected = tagOf(requestId);
+            if (slot.tag.compare_exchange_strong(expected, CLAIMED, std::memory_order_acquire)) {
+                auto awaiter = slot.awaiter;
+                slot.awaiter = nullptr;
+                slot.tag.store(FREE, std::memory_order_release);
+                --outstanding;
+                return awaiter;
+            }
+            std::lock_guard lock(mutex);
+            auto p = overflow.find(requestId);
+            if (p == overflow.end()) {
+                return nullptr;
+            }
+            auto awaiter = p->second;
+            overflow.erase(p);
+            --outstanding;
+            return awaiter;
+        }
+
+    public:
+        RequestTable() = default;
+        RequestTable(const RequestTable &) = delete;
+        RequestTable &operator=(const RequestTable &) = delete;
+
+        /**
+         * co_await suspend(requestId) to wait for resume(requestId, value)
+         *
+         * when set, resume() hands the coroutine to schedule instead of
+         * resuming it, e.g. to resume it on another thread, and suspended is
+         * called once the coroutine waits, e.g. to have another thread send
+         * the request
+         */
+        Awaiter suspend(uint32_t requestId, std::function<void(std::coroutine_handle<>)> schedule = {}, std::function<void()> suspended = {}) {
+            return Awaiter{this, requestId, std::move(schedule), std::move(suspended)};
+        }
+        /**
+         * resume the coroutine waiting for requestId with value
+         *
+         * when called by a coroutine being resumed, the coroutine waiting for
+         * requestId only runs after that one suspended or finished, hence the
+         * value must not refer to memory released before, see ResumeQueue
+         *
+         * \return false when nobody waits for requestId (anymore)
+         */
+        bool resume(uint32_t requestId, V value) {
+            auto awaiter = remove(requestId);
+            if (awaiter == nullptr) {
+                return false;
+            }
+            awaiter->value.emplace(std::move(value));
+            if (awaiter->schedule) {
+                awaiter->schedule(awaiter->handle);
+            } else {
+                ResumeQueue::resume(awaiter->handle);
+            }
+            return true;
+        }
+        /**
+         * resume all waiting coroutines with value, e.g. an exception when the
+         * connection was lost
+         */
+        void resumeAll(const V &value) {
+            std::vector<uint32_t> requestIds;
+            for (auto &slot : ring) {
+                auto tag = slot.tag.load(std::memory_order_acquire);
+                if (tag != FREE && tag != CLAIMED) {
+                    requestIds.push_back(uint32_t((tag >> 1) - 1));
+                }
+            }
+            {
+                std::lock_guard lock(mutex);
+                for (auto &entry : overflow) {
+                    requestIds.push_back(entry.first);
+                }
+            }
+            for (auto requestId : requestIds) {
+                resume(requestId, value);
+            }
+        }
+        /**
+         * number of requests waiting for a reply
+         */
+        size_t size() const { return outstanding; }
+        bool empty() const { return outstanding == 0; }
+        /**
+         * number of requests which did not fit into the ring so far
+         */
+        size_t overflows() const { return overflowed; }
+};
+
+}  // namespace detail
+}  // namespace CORBA
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <utility>
+#include <variant>
+#include <vector>
+
+/**
+ * A minimal benchmark harness for corba.cc.
+ *
+ * Benchmarks register themselves with the bench_spec() macro and are run by
+ * bench/main.cc. main.cc also replaces the global operator new so that a
+ * benchmark can count the allocations it caused.
+ *
+ * Besides printing a human readable line, each measurement should be recorded
+ * with report() so that `benchmark --json <file>` writes it out for tracking
+ * regressions between releases.
+ */
+namespace bench {
+
+/**
+ * number of calls to the global operator new since the program started
+ */
+extern std::atomic<size_t> allocations;
+
+struct Benchmark {
+        const char *name;
+        std::function<void()> run;
+};
+
+std::vector<Benchmark> &benchmarks();
+
+struct Register {
+        Register(const char *name, std::function<void()> run) { benchmarks().push_back({name, run}); }
+};
+
+/**
+ * a field of a result: a parameter like the protocol or a measured value
+ */
+using Value = std::variant<std::string, double>;
+
+/**
+ * record a result, e.g.
+ *
+ *   bench::report("orb/latency", {{"protocol", "tcp"}, {"p50_ns", p50}});
+ */
+void report(const char *benchmark, std::vector<std::pair<std::string, Value>> &&fields);
+
+class Stopwatch {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    public:
+        inline double ns() const { return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count(); }
+};
+
+/**
+ * counts the allocations made while the object exists
+ */
+class AllocationCounter {
+        size_t start = allocations.load(std::memory_order_relaxed);
+
+    public:
+        inline size_t count() const { return allocations.load(std::memory_order_relaxed) - start; }
+};
+
+/**
+ * the p-th percentile (0 <= p <= 1) of samples, which will be sorted
+ */
+inline double percentile(std::vector<double> &samples, double p) {
+    if (samples.empty()) {
+        return 0;
+    }
+    std::sort(samples.begin(), samples.end());
+    auto index = static_cast<size_t>(p * (samples.size() - 1) + 0.5);
+    return samples[index];
+}
+
+/**
+ * keep the compiler from optimizing away a computed value
+ */
+template <typename T>
+inline void doNotOptimize(T const &value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+}  // namespace bench
+
+#define BENCH_CONCAT2(a, b) a##b
+#define BENCH_CONCAT(a, b) BENCH_CONCAT2(a, b)
+#define bench_spec(name, ...) static bench::Register BENCH_CONCAT(_bench_, __LINE__)(name, __VA_ARGS__)
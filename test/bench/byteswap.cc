@@ -0,0 +1,79 @@
+#include <bit>
+#include <cstring>
+#include <print>
+#include <vector>
+
+#include "../../src/corba/cdr.hh"
+#include "bench.hh"
+
+using namespace std;
+
+namespace {
+
+const size_t ELEMENTS = 1000000;
+const size_t N = 50;
+
+/**
+ * a sequence of ELEMENTS values encoded in the other endianness
+ */
+template <typename T>
+vector<char> foreignSequence() {
+    vector<char> buffer(8 + ELEMENTS * sizeof(T));
+    uint32_t size = std::byteswap(static_cast<uint32_t>(ELEMENTS));
+    memcpy(buffer.data(), &size, 4);
+    size_t offset = sizeof(T) == 8 ? 8 : 4;
+    for (size_t i = 0; i < ELEMENTS; ++i) {
+        T value = std::byteswap(static_cast<T>(i * 0x01010101));
+        memcpy(buffer.data() + offset + i * sizeof(T), &value, sizeof(T));
+    }
+    return buffer;
+}
+
+const endian foreign = endian::native == endian::little ? endian::big : endian::little;
+
+template <typename F>
+void measure(const char *type, const char *label, size_t elementSize, F &&once) {
+    bench::Stopwatch watch;
+    for (size_t i = 0; i < N; ++i) {
+        once();
+    }
+    auto ns = watch.ns() / N;
+    auto gbps = ELEMENTS * elementSize / ns;
+    println("    {:<10} {:<24} {:10.1f} us/sequence {:6.2f} GB/s", type, label, ns / 1000, gbps);
+    bench::report("cdr/byteswap", {{"type", type}, {"variant", label}, {"elements", double(ELEMENTS)}, {"ns_per_sequence", ns}, {"gb_per_s", gbps}});
+}
+
+template <typename T, typename Element, typename Vector, typename Span>
+void sweep(const char *type, Element readElement, Vector readVector, Span readSpan) {
+    auto buffer = foreignSequence<T>();
+    measure(type, "element by element", sizeof(T), [&] {
+        CORBA::CDRDecoder decoder(buffer.data(), buffer.size(), foreign);
+        vector<T> out(decoder.readUlong());
+        for (auto &value : out) {
+            value = (decoder.*readElement)();
+        }
+        bench::doNotOptimize(out.data());
+    });
+    measure(type, "vector", sizeof(T), [&] {
+        CORBA::CDRDecoder decoder(buffer.data(), buffer.size(), foreign);
+        auto out = (decoder.*readVector)();
+        bench::doNotOptimize(out.data());
+    });
+    measure(type, "span", sizeof(T), [&] {
+        CORBA::CDRDecoder decoder(buffer.data(), buffer.size(), foreign);
+        auto out = (decoder.*readSpan)();
+        bench::doNotOptimize(out.data());
+    });
+}
+
+}  // namespace
+
+bench_spec("cdr/byteswap", [] {
+    println("  sequences of {} elements from a peer of the other endianness", ELEMENTS);
+    sweep<uint16_t>("ushort", &CORBA::CDRDecoder::readUshort, &CORBA::CDRDecoder::readSequenceVectorUshort,
+                    &CORBA::CDRDecoder::readSequenceSpanUshort);
+    sweep<uint32_t>("ulong", &CORBA::CDRDecoder::readUlong, &CORBA::CDRDecoder::readSequenceVectorUlong,
+                    &CORBA::CDRDecoder::readSequenceSpanUlong);
+    sweep<uint64_t>("ulonglong", &CORBA::CDRDecoder::readUlonglong, &CORBA::CDRDecoder::readSequenceVectorUlonglong,
+                    &CORBA::CDRDecoder::readSequenceSpanUlonglong);
+});
@@ -0,0 +1,119 @@
+#include <cstring>
+#include <print>
+#include <string>
+#include <vector>
+
+#include "../../src/corba/cdr.hh"
+#include "bench.hh"
+
+using namespace std;
+
+namespace {
+
+/**
+ * the CDREncoder's buffer management before it grew geometrically: every
+ * write resized the value initialized std::vector<char> to the exact size
+ */
+struct ExactResizeEncoder {
+        unique_ptr<vector<char>> _data = make_unique<vector<char>>();
+        size_t offset = 0;
+
+        inline void reserve(size_t nbytes) {
+            if (_data->size() < nbytes) {
+                _data->resize(nbytes);
+            }
+        }
+        void writeUlong(uint32_t value) {
+            if (offset & 0x03) {
+                offset = (offset | 0x03) + 1;
+            }
+            reserve(offset + 4);
+            memcpy(_data->data() + offset, &value, 4);
+            offset += 4;
+        }
+        void writeString(const char *value, size_t nbytes) {
+            writeUlong(nbytes + 1);
+            reserve(offset + nbytes + 1);
+            memcpy(_data->data() + offset, value, nbytes);
+            offset += nbytes;
+            _data->at(offset) = 0;
+            ++offset;
+        }
+        void writeSequence(const span<double> &value) {
+            writeUlong(value.size());
+            if (offset & 0x07) {
+                offset = (offset | 0x07) + 1;
+            }
+            auto nbytes = 8 * value.size();
+            reserve(offset + nbytes);
+            memcpy(_data->data() + offset, value.data(), nbytes);
+            offset += nbytes;
+        }
+};
+
+const size_t N = 100000;
+
+/**
+ * a message resembling a typical call: some header fields, a few strings and a sequence<double>
+ */
+template <typename E>
+void encode(E &encoder, const string &text, const span<double> &seq) {
+    for (uint32_t i = 0; i < 8; ++i) {
+        encoder.writeUlong(i);
+    }
+    for (int i = 0; i < 4; ++i) {
+        encoder.writeString(text.data(), text.size());
+    }
+    encoder.writeSequence(seq);
+}
+
+template <typename F>
+void measure(const char *label, size_t nseq, F &&once) {
+    bench::AllocationCounter allocs;
+    bench::Stopwatch watch;
+    for (size_t i = 0; i < N; ++i) {
+        once();
+    }
+    auto ns = watch.ns();
+    println("    {:<24} {:8.2f} allocations/message {:10.1f} ns/message", label, double(allocs.count()) / N, ns / N);
+    bench::report("cdr/encoder", {{"variant", label}, {"elements", double(nseq)}, {"allocations_per_message", double(allocs.count()) / N}, {"ns_per_message", ns / N}});
+}
+
+void sweep(size_t nseq) {
+    string text("IDL:omg.org/CosNaming/NamingContextExt:1.0");
+    vector<double> values(nseq, 3.1415);
+    span<double> seq(values);
+    size_t hint = 8 * 4 + 4 * (4 + text.size() + 1) + 8 + nseq * 8;
+    println("  sequence<double> with {} elements", nseq);
+
+    measure("exact resize (before)", nseq, [&] {
+        ExactResizeEncoder encoder;
+        encode(encoder, text, seq);
+        bench::doNotOptimize(encoder._data->data());
+    });
+    measure("geometric", nseq, [&] {
+        CORBA::CDREncoder encoder;
+        encode(encoder, text, seq);
+        bench::doNotOptimize(encoder._data->data());
+    });
+    measure("geometric + size hint", nseq, [&] {
+        CORBA::CDREncoder encoder(nullptr, hint);
+        encode(encoder, text, seq);
+        bench::doNotOptimize(encoder._data->data());
+    });
+    CORBA::detail::BufferPool pool;
+    measure("geometric + buffer pool", nseq, [&] {
+        CORBA::CDREncoder encoder(&pool);
+        encode(encoder, text, seq);
+        bench::doNotOptimize(encoder._data->data());
+        pool.release(std::move(encoder._data));
+    });
+}
+
+}  // namespace
+
+bench_spec("cdr/encoder", [] {
+    for (auto nseq : {0uz, 16uz, 1024uz}) {
+        sweep(nseq);
+    }
+});
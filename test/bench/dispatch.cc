@@ -0,0 +1,81 @@
+#include <print>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "../../src/corba/util/operationtable.hh"
+#include "bench.hh"
+
+using namespace std;
+using CORBA::detail::OperationTable;
+
+namespace {
+
+const size_t N = 1000000;
+
+constexpr OperationTable naming({"resolve", "resolve_str"});
+
+// the operations and attributes of Interface in interface/interface.idl
+constexpr OperationTable interface({"_get_roAttribute", "_get_rwAttribute", "_set_rwAttribute", "callBoolean", "callOctet",
+                                    "callUShort", "callUnsignedLong", "callUnsignedLongLong", "callShort", "callLong",
+                                    "callLongLong", "callFloat", "callDouble", "callString", "recvString",
+                                    "callBlob", "callStruct", "callSeqFloat", "callSeqDouble", "callSeqString",
+                                    "callSeqRGBA", "getRemoteObjects", "setPeer", "getPeer", "callPeer"});
+
+constexpr OperationTable synthetic({
+    "operation0", "operation1", "operation2", "operation3", "operation4", "operation5", "operation6", "operation7",
+    "operation8", "operation9", "operation10", "operation11", "operation12", "operation13", "operation14", "operation15",
+    "operation16", "operation17", "operation18", "operation19", "operation20", "operation21", "operation22", "operation23",
+    "operation24", "operation25", "operation26", "operation27", "operation28", "operation29", "operation30", "operation31",
+    "operation32", "operation33", "operation34", "operation35", "operation36", "operation37", "operation38", "operation39",
+    "operation40", "operation41", "operation42", "operation43", "operation44", "operation45", "operation46", "operation47",
+    "operation48", "operation49", "operation50", "operation51", "operation52", "operation53", "operation54", "operation55",
+    "operation56", "operation57", "operation58", "operation59", "operation60", "operation61", "operation62", "operation63"});
+
+/**
+ * what the skeletons did before: one string compare per operation until
+ * the operation is found
+ */
+template <size_t S>
+int chain(const OperationTable<S> &table, const string_view &operation) {
+    for (size_t i = 0; i < S; ++i) {
+        if (operation == table[i]) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+template <size_t S>
+void sweep(const char *label, const OperationTable<S> &table) {
+    // the operation names as they arrive: copied out of a request
+    vector<string> requests;
+    for (size_t i = 0; i < S; ++i) {
+        requests.emplace_back(table[i]);
+    }
+    println("  {} ({} operations)", label, S);
+
+    bench::Stopwatch chainWatch;
+    for (size_t i = 0; i < N; ++i) {
+        bench::doNotOptimize(chain(table, requests[i % S]));
+    }
+    auto chainNs = chainWatch.ns();
+    println("    {:<24} {:10.1f} ns/dispatch", "string compare chain", chainNs / N);
+    bench::report("skeleton/dispatch", {{"interface", label}, {"operations", double(S)}, {"variant", "chain"}, {"ns_per_dispatch", chainNs / N}});
+
+    bench::Stopwatch hashWatch;
+    for (size_t i = 0; i < N; ++i) {
+        bench::doNotOptimize(table.find(requests[i % S]));
+    }
+    auto hashNs = hashWatch.ns();
+    println("    {:<24} {:10.1f} ns/dispatch", "perfect hash", hashNs / N);
+    bench::report("skeleton/dispatch", {{"interface", label}, {"operations", double(S)}, {"variant", "perfect hash"}, {"ns_per_dispatch", hashNs / N}});
+}
+
+}  // namespace
+
+bench_spec("skeleton/dispatch", [] {
+    sweep("NamingContextExt", naming);
+    sweep("Interface", interface);
+    sweep("synthetic", synthetic);
+});
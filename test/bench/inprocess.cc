@@ -0,0 +1,80 @@
+#include "inprocess.hh"
+
+#include <map>
+#include <stdexcept>
+
+#include "../../src/corba/orb.hh"
+
+using namespace std;
+
+static map<pair<string, unsigned>, InProcessProtocol *> listeners;
+
+InProcessProtocol::InProcessProtocol(struct ev_loop *loop) : Protocol(loop) { ev_idle_init(&idle_watcher, libev_idle_cb); }
+
+InProcessProtocol::~InProcessProtocol() {
+    shutdown();
+    ev_idle_stop(loop, &idle_watcher);
+}
+
+void InProcessProtocol::listen(const char *host, unsigned port) {
+    local.host = host;
+    local.port = port;
+    listeners[{local.host, port}] = this;
+}
+
+void InProcessProtocol::shutdown() {
+    auto listener = listeners.find({local.host, local.port});
+    if (listener != listeners.end() && listener->second == this) {
+        listeners.erase(listener);
+    }
+}
+
+shared_ptr<CORBA::detail::Connection> InProcessProtocol::connectOutgoing(const char *host, unsigned port) {
+    auto listener = listeners.find({host, port});
+    if (listener == listeners.end()) {
+        throw runtime_error(format("InProcessProtocol::connectOutgoing({}, {}): nobody is listening", host, port));
+    }
+    auto server = listener->second;
+    auto outgoing = make_shared<InProcessConnection>(this, host, port);
+    auto incoming = make_shared<InProcessConnection>(server, local.host.c_str(), local.port);
+    outgoing->peer = incoming;
+    incoming->peer = outgoing;
+    outgoing->state = CORBA::detail::ConnectionState::ESTABLISHED;
+    incoming->state = CORBA::detail::ConnectionState::ESTABLISHED;
+    server->orb->connections.insert(incoming);
+    return outgoing;
+}
+
+shared_ptr<CORBA::detail::Connection> InProcessProtocol::connectIncoming(const char *host, unsigned port, int fd) {
+    throw runtime_error("InProcessProtocol::connectIncoming(): connections are created by connectOutgoing()");
+}
+
+void InProcessConnection::send(unique_ptr<CORBA::detail::Buffer> &&buffer) {
+    auto to = peer.lock();
+    if (!to) {
+        bufferPool.release(move(buffer));
+        return;
+    }
+    auto sender = static_cast<InProcessProtocol *>(protocol);
+    sender->queue.push_back({static_pointer_cast<InProcessConnection>(shared_from_this()), to, move(buffer)});
+    ev_idle_start(sender->loop, &sender->idle_watcher);
+}
+
+void InProcessProtocol::libev_idle_cb(struct ev_loop *loop, struct ev_idle *watcher, int revents) {
+    auto protocol = reinterpret_cast<InProcessProtocol *>(reinterpret_cast<char *>(watcher) - offsetof(InProcessProtocol, idle_watcher));
+    protocol->deliver();
+}
+
+void InProcessProtocol::deliver() {
+    // messages send while delivering restart the watcher and are delivered in the next iteration
+    auto pending = std::move(queue);
+    queue.clear();
+    ev_idle_stop(loop, &idle_watcher);
+    for (auto &message : pending) {
+        auto receiver = message.to->protocol->orb;
+        if (receiver) {
+            receiver->socketRcvd(message.to.get(), message.buffer->data(), message.buffer->size());
+        }
+        message.from->bufferPool.release(std::move(message.buffer));
+    }
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <deque>
+#include <memory>
+
+#include "../../src/corba/net/protocol.hh"
+
+class InProcessConnection;
+
+/**
+ * A protocol connecting ORBs which run in the same process and event loop.
+ *
+ * Messages are handed to the receiving ORB from an ev_idle watcher, so
+ * neither sockets nor the kernel are involved and a benchmark measures the
+ * ORB alone.
+ *
+ * listen() registers the protocol under it's host and port and
+ * connectOutgoing() looks up the listening protocol and creates the
+ * connections on both ends.
+ */
+class InProcessProtocol : public CORBA::detail::Protocol {
+        friend class InProcessConnection;
+
+        struct Message {
+                std::shared_ptr<InProcessConnection> from;
+                std::shared_ptr<InProcessConnection> to;
+                std::unique_ptr<CORBA::detail::Buffer> buffer;
+        };
+        std::deque<Message> queue;
+        ev_idle idle_watcher;
+        static void libev_idle_cb(struct ev_loop *loop, struct ev_idle *watcher, int revents);
+        void deliver();
+
+    public:
+        InProcessProtocol(struct ev_loop *loop);
+        ~InProcessProtocol() override;
+
+        void listen(const char *host, unsigned port) override;
+        void shutdown() override;
+
+        std::shared_ptr<CORBA::detail::Connection> connectOutgoing(const char *host, unsigned port) override;
+        std::shared_ptr<CORBA::detail::Connection> connectIncoming(const char *host, unsigned port, int fd) override;
+};
+
+class InProcessConnection : public CORBA::detail::Connection {
+    public:
+        std::weak_ptr<InProcessConnection> peer;
+
+        InProcessConnection(InProcessProtocol *protocol, const char *host, uint16_t port) : Connection(protocol, host, port) {}
+
+        void up() override {}
+        void send(std::unique_ptr<CORBA::detail::Buffer> &&buffer) override;
+};
@@ -0,0 +1,76 @@
+#include <print>
+
+#include "../../src/corba/corba.hh"
+#include "../../src/corba/net/tcp/protocol.hh"
+#include "../interface/interface_impl.hh"
+#include "../util.hh"
+#include "bench.hh"
+
+using namespace std;
+using CORBA::async;
+
+namespace {
+
+const size_t WARMUP = 1000;
+const size_t N = 20000;
+
+/**
+ * twoway callLong() round trips between two ORBs over loopback
+ */
+void twowayLatency(bool eagerWrite, unsigned port) {
+    struct ev_loop *loop = EV_DEFAULT;
+
+    auto serverORB = make_shared<CORBA::ORB>("server");
+    auto serverProto = new CORBA::detail::TcpProtocol(loop);
+    serverProto->eagerWrite = eagerWrite;
+    serverORB->registerProtocol(serverProto);
+    serverProto->listen("127.0.0.1", port);
+    auto backend = make_shared<Interface_impl>(serverORB);
+    serverORB->bind("Backend", backend);
+
+    auto clientORB = make_shared<CORBA::ORB>("client");
+    auto clientProto = new CORBA::detail::TcpProtocol(loop);
+    clientProto->eagerWrite = eagerWrite;
+    clientORB->registerProtocol(clientProto);
+
+    vector<double> samples;
+    samples.reserve(N);
+
+    std::exception_ptr eptr;
+    parallel(eptr, loop, [clientORB, port, &samples] -> async<> {
+        auto object = co_await clientORB->stringToObject(format("corbaname::127.0.0.1:{}#Backend", port));
+        auto backend = Interface::_narrow(object);
+        for (size_t i = 0; i < WARMUP; ++i) {
+            co_await backend->callLong(i);
+        }
+        for (size_t i = 0; i < N; ++i) {
+            bench::Stopwatch watch;
+            co_await backend->callLong(i);
+            samples.push_back(watch.ns());
+        }
+    });
+    ev_run(loop, 0);
+    if (eptr) {
+        std::rethrow_exception(eptr);
+    }
+    serverProto->shutdown();
+
+    double total = 0;
+    for (auto ns : samples) {
+        total += ns;
+    }
+    auto mean = total / samples.size();
+    auto p50 = bench::percentile(samples, 0.5);
+    auto p99 = bench::percentile(samples, 0.99);
+    println("    {:<24} mean {:8.1f} us  p50 {:8.1f} us  p99 {:8.1f} us", eagerWrite ? "eager write" : "write watcher", mean / 1000, p50 / 1000,
+            p99 / 1000);
+    bench::report("tcp/latency", {{"variant", eagerWrite ? "eager write" : "write watcher"}, {"mean_ns", mean}, {"p50_ns", p50}, {"p99_ns", p99}});
+}
+
+}  // namespace
+
+bench_spec("tcp/latency", [] {
+    println("  twoway callLong() over loopback, {} calls", N);
+    twowayLatency(false, 9110);
+    twowayLatency(true, 9111);
+});
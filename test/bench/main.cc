@@ -0,0 +1,144 @@
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <print>
+
+#include <unistd.h>
+
+#include "bench.hh"
+
+namespace bench {
+
+std::atomic<size_t> allocations = 0;
+
+std::vector<Benchmark> &benchmarks() {
+    static std::vector<Benchmark> list;
+    return list;
+}
+
+struct Result {
+        const char *benchmark;
+        std::vector<std::pair<std::string, Value>> fields;
+};
+
+static std::vector<Result> results;
+
+void report(const char *benchmark, std::vector<std::pair<std::string, Value>> &&fields) { results.push_back({benchmark, std::move(fields)}); }
+
+static std::string quote(const std::string_view &text) {
+    std::string result = "\"";
+    for (auto c : text) {
+        switch (c) {
+            case '"':
+                result += "\\\"";
+                break;
+            case '\\':
+                result += "\\\\";
+                break;
+            case '\n':
+                result += "\\n";
+                break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    result += std::format("\\u{:04x}", static_cast<unsigned>(c));
+                } else {
+                    result += c;
+                }
+        }
+    }
+    result += '"';
+    return result;
+}
+
+static std::string json(const Value &value) {
+    if (auto text = std::get_if<std::string>(&value)) {
+        return quote(*text);
+    }
+    auto number = std::get<double>(value);
+    return std::isfinite(number) ? std::format("{}", number) : "null";
+}
+
+/**
+ * write all results as {"results": [{"benchmark": ..., <field>: <value>, ...}, ...]}
+ */
+static void writeJSON(FILE *file) {
+    std::println(file, "{{\n  \"results\": [");
+    for (size_t i = 0; i < results.size(); ++i) {
+        auto &result = results[i];
+        std::print(file, "    {{\"benchmark\": {}", quote(result.benchmark));
+        for (auto &field : result.fields) {
+            std::print(file, ", {}: {}", quote(field.first), json(field.second));
+        }
+        std::println(file, "}}{}", i + 1 < results.size() ? "," : "");
+    }
+    std::println(file, "  ]\n}}");
+}
+
+}  // namespace bench
+
+void *operator new(size_t size) {
+    bench::allocations.fetch_add(1, std::memory_order_relaxed);
+    if (auto ptr = std::malloc(size ? size : 1)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+void operator delete(void *ptr, size_t) noexcept { std::free(ptr); }
+
+/**
+ * usage: bench [--json file] [name...]
+ *
+ * runs all benchmarks or those whose name starts with one of the arguments
+ * and optionally writes the results as JSON into file ('-' for stdout, in
+ * which case the progress output goes to stderr to keep stdout parseable)
+ */
+int main(int argc, char *argv[]) {
+    const char *jsonFile = nullptr;
+    int first = 1;
+    if (argc > 2 && strcmp(argv[1], "--json") == 0) {
+        jsonFile = argv[2];
+        first = 3;
+    }
+    FILE *json = nullptr;
+    if (jsonFile && strcmp(jsonFile, "-") == 0) {
+        // keep the original stdout for the JSON and send everything printed
+        // by the benchmarks to stderr
+        fflush(stdout);
+        auto fd = dup(STDOUT_FILENO);
+        if (fd < 0 || !(json = fdopen(fd, "w")) || dup2(STDERR_FILENO, STDOUT_FILENO) < 0) {
+            std::println(stderr, "failed to redirect stdout: {}", strerror(errno));
+            return 1;
+        }
+    }
+    for (auto &benchmark : bench::benchmarks()) {
+        bool selected = argc <= first;
+        for (int i = first; i < argc; ++i) {
+            if (strncmp(benchmark.name, argv[i], strlen(argv[i])) == 0) {
+                selected = true;
+            }
+        }
+        if (selected) {
+            std::println("{}", benchmark.name);
+            benchmark.run();
+        }
+    }
+    if (jsonFile) {
+        if (json) {
+            bench::writeJSON(json);
+            fclose(json);
+        } else {
+            auto file = fopen(jsonFile, "w");
+            if (!file) {
+                std::println(stderr, "failed to open {}: {}", jsonFile, strerror(errno));
+                return 1;
+            }
+            bench::writeJSON(file);
+            fclose(file);
+        }
+    }
+    return 0;
+}
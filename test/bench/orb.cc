@@ -0,0 +1,288 @@
+#include <algorithm>
+#include <print>
+
+#include "../../src/corba/corba.hh"
+#include "../../src/corba/net/tcp/protocol.hh"
+#include "../../src/corba/net/ws/protocol.hh"
+#include "../interface/interface_impl.hh"
+#include "../util.hh"
+#include "bench.hh"
+#include "inprocess.hh"
+
+using namespace std;
+using CORBA::async;
+
+namespace {
+
+const size_t WARMUP = 1000;
+const size_t LATENCY_CALLS = 20000;
+const size_t ONEWAY_CALLS = 100000;
+const size_t PIPELINED_CALLS = 100000;
+/**
+ * number of bytes a payload sweep transfers per size
+ */
+const size_t SWEEP_BYTES = 0x4000000;
+
+enum class Transport { TCP, WS, INPROCESS };
+
+const char *name(Transport transport) {
+    switch (transport) {
+        case Transport::TCP:
+            return "tcp";
+        case Transport::WS:
+            return "ws";
+        case Transport::INPROCESS:
+            return "inprocess";
+    }
+    return "?";
+}
+
+/**
+ * Interface_impl without the println() in recvString(), counting the oneway
+ * calls instead
+ */
+class Backend : public Interface_impl {
+    public:
+        struct ev_loop *loop;
+        size_t received = 0;
+        size_t expected = 0;
+
+        Backend(shared_ptr<CORBA::ORB> orb, struct ev_loop *loop) : Interface_impl(orb), loop(loop) {}
+        void recvString(const std::string_view &value) override {
+            if (++received == expected) {
+                ev_break(loop);
+            }
+        }
+};
+
+/**
+ * run closure on the event loop until it has finished
+ */
+void run(struct ev_loop *loop, function<async<>()> closure) {
+    std::exception_ptr eptr;
+    parallel(eptr, loop, closure);
+    ev_run(loop, 0);
+    if (eptr) {
+        std::rethrow_exception(eptr);
+    }
+}
+
+/**
+ * a server and a client ORB connected via transport
+ */
+struct Peers {
+        struct ev_loop *loop = EV_DEFAULT;
+        Transport transport;
+        shared_ptr<CORBA::ORB> serverORB;
+        shared_ptr<CORBA::ORB> clientORB;
+        CORBA::detail::Protocol *serverProto;
+        shared_ptr<Backend> impl;
+        shared_ptr<Interface> backend;
+
+        Peers(Transport transport, unsigned port) : transport(transport) {
+            serverORB = make_shared<CORBA::ORB>("server");
+            clientORB = make_shared<CORBA::ORB>("client");
+            const char *host = "127.0.0.1";
+            switch (transport) {
+                case Transport::TCP:
+                    serverProto = new CORBA::detail::TcpProtocol(loop);
+                    clientORB->registerProtocol(new CORBA::detail::TcpProtocol(loop));
+                    break;
+                case Transport::WS:
+                    serverProto = new CORBA::detail::WsProtocol(loop);
+                    clientORB->registerProtocol(new CORBA::detail::WsProtocol(loop));
+                    break;
+                case Transport::INPROCESS:
+                    host = "inprocess";
+                    serverProto = new InProcessProtocol(loop);
+                    clientORB->registerProtocol(new InProcessProtocol(loop));
+                    break;
+            }
+            serverORB->registerProtocol(serverProto);
+            serverProto->listen(host, port);
+            impl = make_shared<Backend>(serverORB, loop);
+            serverORB->bind("Backend", impl);
+
+            auto url = format("corbaname::{}:{}#Backend", host, port);
+            run(loop, [this, url] -> async<> {
+                auto object = co_await clientORB->stringToObject(url);
+                backend = Interface::_narrow(object);
+            });
+        }
+        ~Peers() {
+            backend = nullptr;
+            serverProto->shutdown();
+        }
+};
+
+/**
+ * twoway callLong() round trips, one at a time
+ */
+void latency(Peers &peers) {
+    vector<double> samples;
+    samples.reserve(LATENCY_CALLS);
+    run(peers.loop, [&peers, &samples] -> async<> {
+        auto backend = peers.backend;
+        for (size_t i = 0; i < WARMUP; ++i) {
+            co_await backend->callLong(i);
+        }
+        for (size_t i = 0; i < LATENCY_CALLS; ++i) {
+            bench::Stopwatch watch;
+            co_await backend->callLong(i);
+            samples.push_back(watch.ns());
+        }
+    });
+
+    double total = 0;
+    for (auto ns : samples) {
+        total += ns;
+    }
+    auto mean = total / samples.size();
+    auto p50 = bench::percentile(samples, 0.5);
+    auto p99 = bench::percentile(samples, 0.99);
+    auto p999 = bench::percentile(samples, 0.999);
+    println("    {:<10} twoway latency  mean {:8.1f} us  p50 {:8.1f} us  p99 {:8.1f} us  p999 {:8.1f} us", name(peers.transport), mean / 1000,
+            p50 / 1000, p99 / 1000, p999 / 1000);
+    bench::report("orb/latency", {{"protocol", name(peers.transport)},
+                                  {"calls", double(LATENCY_CALLS)},
+                                  {"mean_ns", mean},
+                                  {"p50_ns", p50},
+                                  {"p99_ns", p99},
+                                  {"p999_ns", p999}});
+}
+
+/**
+ * oneway recvString() calls send back to back until the server got all of them
+ */
+void oneway(Peers &peers) {
+    peers.impl->received = 0;
+    peers.impl->expected = ONEWAY_CALLS;
+    bench::Stopwatch watch;
+    for (size_t i = 0; i < ONEWAY_CALLS; ++i) {
+        peers.backend->recvString("hello");
+    }
+    ev_run(peers.loop, 0);
+    auto ns = watch.ns();
+    auto rate = ONEWAY_CALLS / (ns / 1e9);
+    println("    {:<10} oneway          {:10.0f} calls/s", name(peers.transport), rate);
+    bench::report("orb/oneway", {{"protocol", name(peers.transport)}, {"calls", double(ONEWAY_CALLS)}, {"calls_per_s", rate}});
+}
+
+/**
+ * outstanding coroutines each doing twoway callLong() calls back to back, so
+ * that up to outstanding requests and replies are in flight
+ */
+void pipelined(Peers &peers, size_t outstanding) {
+    std::exception_ptr eptr;
+    size_t running = outstanding;
+    auto perWorker = PIPELINED_CALLS / outstanding;
+    auto loop = peers.loop;
+    bench::Stopwatch watch;
+    for (size_t i = 0; i < outstanding; ++i) {
+        [](shared_ptr<Interface> backend, size_t n) -> async<> {
+            for (size_t j = 0; j < n; ++j) {
+                co_await backend->callLong(j);
+            }
+        }(peers.backend, perWorker)
+            .thenOrCatch(
+                [&running, loop] {
+                    if (--running == 0) {
+                        ev_break(loop);
+                    }
+                },
+                [&running, &eptr, loop](std::exception_ptr _eptr) {
+                    eptr = _eptr;
+                    if (--running == 0) {
+                        ev_break(loop);
+                    }
+                });
+    }
+    ev_run(loop, 0);
+    auto ns = watch.ns();
+    if (eptr) {
+        std::rethrow_exception(eptr);
+    }
+    auto calls = perWorker * outstanding;
+    auto rate = calls / (ns / 1e9);
+    println("    {:<10} pipelined {:4} outstanding {:10.0f} calls/s", name(peers.transport), outstanding, rate);
+    bench::report("orb/pipelined", {{"protocol", name(peers.transport)}, {"outstanding", double(outstanding)}, {"calls", double(calls)}, {"calls_per_s", rate}});
+}
+
+/**
+ * number of calls to transfer SWEEP_BYTES with nbytes per call
+ */
+size_t callsFor(size_t nbytes) { return clamp(SWEEP_BYTES / nbytes, 10uz, 20000uz); }
+
+void printSweep(Peers &peers, const char *operation, size_t elements, size_t nbytes, size_t calls, double ns) {
+    auto perCall = ns / calls;
+    auto throughput = 2.0 * nbytes * calls / (ns / 1e9) / 1e6;
+    println("    {:<10} {:<14} {:8} elements {:10.1f} us/call {:10.1f} MB/s", name(peers.transport), operation, elements, perCall / 1000, throughput);
+    bench::report("orb/payload", {{"protocol", name(peers.transport)},
+                                  {"operation", operation},
+                                  {"elements", double(elements)},
+                                  {"bytes", double(nbytes)},
+                                  {"calls", double(calls)},
+                                  {"ns_per_call", perCall},
+                                  {"mb_per_s", throughput}});
+}
+
+void sweepBlob(Peers &peers) {
+    for (auto size : {16uz, 1024uz, 0x10000uz, 0x100000uz}) {
+        string data(size, 'x');
+        auto calls = callsFor(size);
+        bench::Stopwatch watch;
+        run(peers.loop, [&peers, &data, calls] -> async<> {
+            for (size_t i = 0; i < calls; ++i) {
+                co_await peers.backend->callBlob(CORBA::blob_view(data));
+            }
+        });
+        printSweep(peers, "callBlob", size, size, calls, watch.ns());
+    }
+}
+
+void sweepSeqDouble(Peers &peers) {
+    for (auto size : {1uz, 128uz, 8192uz, 131072uz}) {
+        vector<double> data(size, 3.1415);
+        auto calls = callsFor(size * 8);
+        bench::Stopwatch watch;
+        run(peers.loop, [&peers, &data, calls] -> async<> {
+            for (size_t i = 0; i < calls; ++i) {
+                co_await peers.backend->callSeqDouble(data);
+            }
+        });
+        printSweep(peers, "callSeqDouble", size, size * 8, calls, watch.ns());
+    }
+}
+
+void sweepSeqString(Peers &peers) {
+    const string text("a sixteen byte s");
+    for (auto size : {1uz, 128uz, 8192uz}) {
+        vector<string_view> data(size, text);
+        auto calls = callsFor(size * (4 + text.size() + 1));
+        bench::Stopwatch watch;
+        run(peers.loop, [&peers, &data, calls] -> async<> {
+            for (size_t i = 0; i < calls; ++i) {
+                co_await peers.backend->callSeqString(data);
+            }
+        });
+        printSweep(peers, "callSeqString", size, size * (4 + text.size() + 1), calls, watch.ns());
+    }
+}
+
+void suite(Transport transport, unsigned port) {
+    Peers peers(transport, port);
+    latency(peers);
+    oneway(peers);
+    for (auto outstanding : {1uz, 16uz, 128uz}) {
+        pipelined(peers, outstanding);
+    }
+    sweepBlob(peers);
+    sweepSeqDouble(peers);
+    sweepSeqString(peers);
+}
+
+}  // namespace
+
+bench_spec("orb/tcp", [] { suite(Transport::TCP, 9130); });
+bench_spec("orb/ws", [] { suite(Transport::WS, 9131); });
+bench_spec("orb/inprocess", [] { suite(Transport::INPROCESS, 1); });
@@ -0,0 +1,93 @@
+#include <print>
+
+#include "../../src/corba/corba.hh"
+#include "../../src/corba/net/tcp/protocol.hh"
+#include "../interface/interface_impl.hh"
+#include "../util.hh"
+#include "bench.hh"
+
+using namespace std;
+using CORBA::async;
+
+namespace {
+
+const size_t CALLS = 100000;
+
+/**
+ * outstanding coroutines each doing twoway callLong() calls back to back
+ * over loopback, so that up to outstanding requests and replies are in flight
+ */
+void pipelined(size_t readBudget, unsigned port, size_t outstanding) {
+    struct ev_loop *loop = EV_DEFAULT;
+
+    auto serverORB = make_shared<CORBA::ORB>("server");
+    auto serverProto = new CORBA::detail::TcpProtocol(loop);
+    serverProto->readBudget = readBudget;
+    serverORB->registerProtocol(serverProto);
+    serverProto->listen("127.0.0.1", port);
+    auto impl = make_shared<Interface_impl>(serverORB);
+    serverORB->bind("Backend", impl);
+
+    auto clientORB = make_shared<CORBA::ORB>("client");
+    auto clientProto = new CORBA::detail::TcpProtocol(loop);
+    clientProto->readBudget = readBudget;
+    clientORB->registerProtocol(clientProto);
+
+    std::exception_ptr eptr;
+    shared_ptr<Interface> backend;
+    parallel(eptr, loop, [clientORB, port, &backend] -> async<> {
+        auto object = co_await clientORB->stringToObject(format("corbaname::127.0.0.1:{}#Backend", port));
+        backend = Interface::_narrow(object);
+    });
+    ev_run(loop, 0);
+    if (eptr) {
+        std::rethrow_exception(eptr);
+    }
+
+    size_t running = outstanding;
+    auto perWorker = CALLS / outstanding;
+    bench::Stopwatch watch;
+    for (size_t i = 0; i < outstanding; ++i) {
+        [](shared_ptr<Interface> backend, size_t n) -> async<> {
+            for (size_t j = 0; j < n; ++j) {
+                co_await backend->callLong(j);
+            }
+        }(backend, perWorker)
+            .thenOrCatch(
+                [&running, loop] {
+                    if (--running == 0) {
+                        ev_break(loop);
+                    }
+                },
+                [&running, &eptr, loop](std::exception_ptr _eptr) {
+                    eptr = _eptr;
+                    if (--running == 0) {
+                        ev_break(loop);
+                    }
+                });
+    }
+    ev_run(loop, 0);
+    auto ns = watch.ns();
+    if (eptr) {
+        std::rethrow_exception(eptr);
+    }
+    backend = nullptr;
+    serverProto->shutdown();
+
+    auto calls = perWorker * outstanding;
+    println("    {:<20} {:4} outstanding {:10.0f} calls/s", readBudget <= 1 ? "one read per event" : "drain socket", outstanding, calls / (ns / 1e9));
+    bench::report("tcp/pipelined", {{"variant", readBudget <= 1 ? "one read per event" : "drain socket"},
+                                    {"outstanding", double(outstanding)},
+                                    {"calls_per_s", calls / (ns / 1e9)}});
+}
+
+}  // namespace
+
+bench_spec("tcp/pipelined", [] {
+    println("  pipelined twoway callLong() over loopback, {} calls", CALLS);
+    unsigned port = 9120;
+    for (auto outstanding : {1uz, 16uz, 128uz}) {
+        pipelined(1, port++, outstanding);
+        pipelined(0x40000, port++, outstanding);
+    }
+});
@@ -1,3 +1,8 @@
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
 #include "../src/corba/cdr.hh"
 #include "kaffeeklatsch.hh"
 
@@ -68,5 +73,69 @@ kaffeeklatsch_spec([] {
                 expect(data.readUlonglong()).equals(0xDEADBEEFC0DEBABE);
             });
         });
+        describe("sequence", [] {
+            it("readSequenceSpanUshort() swaps the elements of a big endian peer into a copy", [] {
+                alignas(8) char buffer[] = "\x00\x00\x00\x03\xDE\xAD\xBE\xEF\xC0\xDE";
+                CORBA::CDRDecoder data(buffer, 10, std::endian::big);
+                auto seq = data.readSequenceSpanUshort();
+                expect(seq.size()).equals(3);
+                expect(seq[0]).equals(0xDEAD);
+                expect(seq[1]).equals(0xBEEF);
+                expect(seq[2]).equals(0xC0DE);
+                expect(buffer[4]).equals('\xDE');
+            });
+            it("readSequenceSpanUlong() refers into an aligned buffer of our byte order", [] {
+                alignas(8) char buffer[12];
+                uint32_t values[] = {2, 0xDEADBEEF, 0xC0DEBABE};
+                memcpy(buffer, values, sizeof(values));
+                CORBA::CDRDecoder data(buffer, 12, std::endian::native);
+                auto seq = data.readSequenceSpanUlong();
+                expect(seq.size()).equals(2);
+                expect(static_cast<const void *>(seq.data()) == buffer + 4).beTrue();
+                expect(seq[1]).equals(0xC0DEBABE);
+            });
+            it("readSequenceSpanUlong() copies the elements of a misaligned buffer", [] {
+                // the message starts at an odd address, hence the aligned offset is not
+                alignas(8) char buffer[13];
+                uint32_t values[] = {2, 0xDEADBEEF, 0xC0DEBABE};
+                memcpy(buffer + 1, values, sizeof(values));
+                CORBA::CDRDecoder data(buffer + 1, 12, std::endian::native);
+                auto seq = data.readSequenceSpanUlong();
+                expect(seq.size()).equals(2);
+                expect(reinterpret_cast<uintptr_t>(seq.data()) % alignof(uint32_t)).equals(0uz);
+                expect(seq[0]).equals(0xDEADBEEF);
+                expect(seq[1]).equals(0xC0DEBABE);
+            });
+            it("readSequenceVectorUlong() decodes a little endian peer", [] {
+                CORBA::CDRDecoder data("\x02\x00\x00\x00\xEF\xBE\xAD\xDE\xBE\xBA\xDE\xC0", 12, std::endian::little);
+                auto seq = data.readSequenceVectorUlong();
+                expect(seq.size()).equals(2);
+                expect(seq[0]).equals(0xDEADBEEF);
+                expect(seq[1]).equals(0xC0DEBABE);
+            });
+            it("readSequenceVectorLonglong() aligns to 8 and leaves the buffer unchanged", [] {
+                const char buffer[] = "\x00\x00\x00\x01....\xDE\xAD\xBE\xEF\xC0\xDE\xBA\xBE";
+                CORBA::CDRDecoder data(buffer, 16, std::endian::big);
+                auto seq = data.readSequenceVectorLonglong();
+                expect(seq.size()).equals(1);
+                expect(static_cast<uint64_t>(seq[0])).equals(0xDEADBEEFC0DEBABE);
+                expect(buffer[8]).equals('\xDE');
+            });
+            it("readSequenceSpanDouble() swaps large sequences", [] {
+                std::vector<double> values(1001);
+                std::vector<char> buffer(8 + 8 * values.size());
+                uint32_t size = std::byteswap(static_cast<uint32_t>(values.size()));
+                memcpy(buffer.data(), &size, 4);
+                for (size_t i = 0; i < values.size(); ++i) {
+                    values[i] = i * 1.5;
+                    auto value = std::byteswap(std::bit_cast<uint64_t>(values[i]));
+                    memcpy(buffer.data() + 8 + 8 * i, &value, 8);
+                }
+                auto foreign = std::endian::native == std::endian::little ? std::endian::big : std::endian::little;
+                CORBA::CDRDecoder data(buffer.data(), buffer.size(), foreign);
+                auto seq = data.readSequenceSpanDouble();
+                expect(std::vector<double>(seq.begin(), seq.end())).equals(values);
+            });
+        });
     });
 });
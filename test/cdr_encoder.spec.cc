@@ -1,3 +1,7 @@
+#include <cstring>
+#include <string>
+#include <vector>
+
 #include "../src/corba/cdr.hh"
 #include "kaffeeklatsch.hh"
 
@@ -35,5 +39,114 @@ kaffeeklatsch_spec([] {
             CORBA::CDRDecoder decoder(encoder);
             expect(decoder.readUlonglong()).equals(0xDEADBEEFC0DEBABE);
         });
+        it("draws it's buffer from a BufferPool", [] {
+            CORBA::detail::BufferPool pool;
+            {
+                CORBA::CDREncoder encoder(&pool);
+                encoder.writeUlong(0xDEADBEEF);
+                expect(pool.stats().misses).equals(1);
+                expect(pool.stats().hits).equals(0);
+                pool.release(std::move(encoder._data));
+            }
+            expect(pool.size()).equals(1);
+
+            CORBA::CDREncoder encoder(&pool);
+            expect(pool.stats().hits).equals(1);
+            expect(encoder._data->size()).equals(0);
+            expect(encoder._data->capacity()).to.not_().equal(0);
+        });
+        it("BufferPool discards buffers exceeding maxBufferCapacity", [] {
+            CORBA::detail::BufferPool pool;
+            pool.maxBufferCapacity = 16;
+            auto buffer = pool.acquire();
+            buffer->resize(32);
+            pool.release(std::move(buffer));
+            expect(pool.size()).equals(0);
+            expect(pool.stats().discarded).equals(1);
+        });
+        it("grows geometrically and zeroes the bytes skipped by alignment", [] {
+            CORBA::detail::BufferPool pool;
+            auto dirty = pool.acquire();
+            dirty->resize(16);
+            memset(dirty->data(), 0xff, 16);
+            pool.release(std::move(dirty));
+
+            CORBA::CDREncoder encoder(&pool);
+            encoder.writeOctet(1);
+            encoder.writeUlonglong(0xDEADBEEFC0DEBABE);
+            expect(encoder.length()).equals(16);
+            for (size_t i = 1; i < 8; ++i) {
+                expect(int(encoder.data()[i])).equals(0);
+            }
+            expect(encoder._data->capacity() >= CORBA::CDREncoder::minCapacity).beTrue();
+        });
+        it("reserves the size hint upfront", [] {
+            CORBA::CDREncoder encoder(nullptr, 4096);
+            expect(encoder._data->capacity() >= 4096).beTrue();
+            expect(encoder.length()).equals(0);
+            auto data = encoder.data();
+            for (int i = 0; i < 1000; ++i) {
+                encoder.writeUlong(i);
+            }
+            expect(encoder.data() == data).beTrue();
+        });
+        it("writeSequenceView() references large sequences instead of copying them", [] {
+            std::vector<double> values(1024);
+            for (size_t i = 0; i < values.size(); ++i) {
+                values[i] = i * 0.5;
+            }
+
+            CORBA::CDREncoder copy;
+            copy.writeOctet(1);
+            copy.reserveSize();
+            copy.writeSequence(values);
+            copy.writeUlong(0xDEADBEEF);
+            copy.fillInSize();
+
+            CORBA::CDREncoder view;
+            view.writeOctet(1);
+            view.reserveSize();
+            view.writeSequenceView(values);
+            view.writeUlong(0xDEADBEEF);
+            view.fillInSize();
+
+            expect(view.segments.size()).equals(1);
+            expect(view.segments[0].data == reinterpret_cast<const char *>(values.data())).beTrue();
+            expect(view.length()).equals(copy.length() - values.size() * 8);
+            expect(view.size()).equals(copy.length());
+
+            std::string spliced(view.data(), view.segments[0].position);
+            spliced.append(view.segments[0].data, view.segments[0].size);
+            spliced.append(view.data() + view.segments[0].position, view.length() - view.segments[0].position);
+            expect(spliced == std::string(copy.data(), copy.length())).beTrue();
+        });
+        it("writeSequenceView() copies small sequences", [] {
+            std::vector<double> values(4);
+            CORBA::CDREncoder encoder;
+            encoder.writeSequenceView(values);
+            expect(encoder.segments.size()).equals(0);
+            expect(encoder.length()).equals(8 + 4 * 8);
+        });
+        it("writeSequence() encodes sequences of integers in bulk", [] {
+            std::vector<int16_t> shorts{-1, 2, 3};
+            std::vector<uint64_t> longlongs{0xDEADBEEFC0DEBABE, 1};
+            std::vector<uint8_t> octets{1, 2, 3, 4, 5};
+            std::vector<bool> booleans{true, false, true};
+
+            CORBA::CDREncoder encoder;
+            encoder.writeSequence(shorts);
+            encoder.writeSequence(longlongs);
+            encoder.writeSequence(octets);
+            encoder.writeSequence(booleans);
+            // length, 3 shorts, padding, length, 2 long longs, length, 5 octets, padding, length, 3 booleans
+            expect(encoder.length()).equals(4 + 6 + 2 + 4 + 16 + 4 + 5 + 3 + 4 + 3);
+
+            CORBA::CDRDecoder decoder(encoder);
+            expect(decoder.readSequenceVectorShort()).equals(shorts);
+            expect(decoder.readSequenceVectorUlonglong()).equals(longlongs);
+            expect(decoder.readSequenceVectorOctet()).equals(octets);
+            expect(decoder.readSequenceVectorBoolean()).equals(booleans);
+            expect(decoder.getOffset()).equals(encoder.length());
+        });
     });
 });
@@ -0,0 +1,116 @@
+#include "../src/corba/cdrstream.hh"
+#include "kaffeeklatsch.hh"
+
+using namespace kaffeeklatsch;
+using namespace std;
+
+static unique_ptr<CORBA::detail::Buffer> chunk(const char *data, size_t size) { return make_unique<CORBA::detail::Buffer>(data, data + size); }
+
+kaffeeklatsch_spec([] {
+    describe("CDRStreamDecoder", [] {
+        it("reads values split over several chunks", [] {
+            CORBA::CDRStreamDecoder data(endian::big);
+            data.append(chunk("A...\xDE\xAD", 6));
+            data.append(chunk("\xBE\xEF\xC0\xDE", 4));
+            expect(data.readOctet()).equals('A');
+            expect(data.available(4, 4)).beTrue();
+            expect(data.readUlong()).equals(0xDEADBEEF);
+            expect(data.available(2, 2)).beTrue();
+            expect(data.readUshort()).equals(0xC0DE);
+            expect(data.available()).equals(0uz);
+        });
+        it("skips the begin of a chunk", [] {
+            CORBA::CDRStreamDecoder data(endian::little);
+            data.append(chunk("\x01\x00", 2));
+            data.append(chunk("HEADER\x02\x00", 8), 6);
+            expect(data.size()).equals(4uz);
+            expect(data.readUshort()).equals(1);
+            expect(data.readUshort()).equals(2);
+        });
+        it("throws when the data has not been received yet", [] {
+            CORBA::CDRStreamDecoder data(endian::big);
+            data.append(chunk("\xDE\xAD", 2));
+            expect(data.available(4, 4)).to.equal(false);
+            string what;
+            try {
+                data.readUlong();
+            } catch (out_of_range &ex) {
+                what = ex.what();
+            }
+            expect(what).to.equal("out of range in CDRStreamDecoder::read(): offset 0 + size 4 > received 2");
+        });
+        it("joins the chunks", [] {
+            CORBA::CDRStreamDecoder data;
+            data.append(chunk("ABC", 3));
+            data.append(chunk("..DEF", 5), 2);
+            auto joined = data.join();
+            expect(string(joined->data(), joined->size())).equals("ABCDEF");
+            expect(data.size()).equals(0uz);
+        });
+        it("discards the chunks which have been read", [] {
+            CORBA::CDRStreamDecoder data;
+            data.append(chunk("AB", 2));
+            data.append(chunk("CD", 2));
+            data.append(chunk("EF", 2));
+            data.skip(3);
+            data.discard();
+            expect(data.readOctet()).equals('D');
+            expect(data.readOctet()).equals('E');
+            data.setOffset(1);
+            bool thrown = false;
+            try {
+                data.readOctet();
+            } catch (out_of_range &) {
+                thrown = true;
+            }
+            expect(thrown).beTrue();
+        });
+    });
+    describe("SequenceReader", [] {
+        it("hands out the elements as they arrive", [] {
+            CORBA::CDRStreamDecoder data(endian::big);
+            CORBA::SequenceReader<uint16_t> reader;
+            vector<uint16_t> values;
+            auto append = [&](span<const uint16_t> chunk) { values.insert(values.end(), chunk.begin(), chunk.end()); };
+
+            data.append(chunk("\x00\x00", 2));
+            expect(reader.read(data, append)).to.equal(false);
+            expect(reader.size().has_value()).to.equal(false);
+
+            data.append(chunk("\x00\x03\x00\x01\x00", 5));
+            expect(reader.read(data, append)).to.equal(false);
+            expect(*reader.size()).equals(3u);
+            expect(values == vector<uint16_t>{1}).beTrue();
+
+            data.append(chunk("\x02\x00\x03", 3));
+            expect(reader.read(data, append)).beTrue();
+            expect(values == vector<uint16_t>{1, 2, 3}).beTrue();
+            expect(reader.complete()).beTrue();
+        });
+        it("aligns the first element", [] {
+            CORBA::CDRStreamDecoder data(endian::little);
+            CORBA::SequenceReader<double> reader;
+            vector<double> values;
+            CORBA::detail::Buffer buffer(16);
+            uint32_t length = 1;
+            double value = 3.1415;
+            memcpy(buffer.data(), &length, 4);
+            memcpy(buffer.data() + 8, &value, 8);
+            data.append(make_unique<CORBA::detail::Buffer>(buffer));
+            expect(reader.read(data, [&](span<const double> chunk) { values.insert(values.end(), chunk.begin(), chunk.end()); })).beTrue();
+            expect(values == vector<double>{3.1415}).beTrue();
+        });
+        it("reads structs of octets", [] {
+            struct RGBA {
+                    uint8_t r, g, b, a;
+            };
+            CORBA::CDRStreamDecoder data(endian::big);
+            CORBA::SequenceReader<RGBA> reader;
+            string pixels;
+            data.append(chunk("\x00\x00\x00\x02" "ab", 6));
+            data.append(chunk("cdefgh", 6));
+            expect(reader.read(data, [&](span<const RGBA> chunk) { pixels.append(reinterpret_cast<const char *>(chunk.data()), chunk.size() * 4); })).beTrue();
+            expect(pixels).equals("abcdefgh");
+        });
+    });
+});
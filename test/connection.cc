@@ -26,6 +26,7 @@ WsConnection::WsConnection(Protocol *protocol, const char *host, uint16_t port,
     : Connection(protocol, host, port) {
         println("{}:{}: {}", __FILE__, __LINE__, __PRETTY_FUNCTION__);
         wsstate = initialState;
+        connectTimer.callback = [this] { timer(); };
     }
 
 void WsConnection::send(unique_ptr<vector<char>> &&buffer) {
@@ -167,7 +168,7 @@ void WsConnection::canWrite() {
             }
             // TODO: when bidirectional or there are packets to be send, go to PENDING instead of IDLE
             state = ConnectionState::IDLE;
-            close(fd);
+            ::close(fd);
             fd = -1;
             return;
         } else {
@@ -192,7 +193,7 @@ void WsConnection::canWrite() {
                 println("{}WsConnection::canWrite(): broken connection -> IDLE", prefix(this));
                 // TODO: when bidirectional or there are packets to be send, go to PENDING instead of IDLE
                 state = ConnectionState::IDLE;
-                close(fd);
+                ::close(fd);
                 fd = -1;
                 return;
             } else if (errno != EAGAIN) {
@@ -252,9 +253,7 @@ void WsConnection::canRead() {
         // TODO: if there packets to be send, switch to pending
         // TODO: have one method to switch the state and perform the needed actions (e.g. handle timers)?
         state = ConnectionState::IDLE;
-        while(!interlock.empty()) {
-            interlock.resume(interlock.begin()->first, make_exception_ptr(TRANSIENT(0, CORBA::CompletionStatus::NO)));
-        }
+        outstanding.resumeAll(make_exception_ptr(TRANSIENT(0, CORBA::CompletionStatus::NO)));
         return;
     }
     println("{}WsConnection::canRead(): state = {}", prefix(this), std::to_underlying(state));
@@ -385,12 +384,6 @@ void WsConnection::libev_write_cb(struct ev_loop *loop, struct ev_io *watcher, i
     connection->canWrite();
 }
 
-void WsConnection::libev_timer_cb(struct ev_loop *loop, struct ev_timer *watcher, int revents) {
-    println("{}:{}: {}", __FILE__, __LINE__, __PRETTY_FUNCTION__);
-    auto connection = reinterpret_cast<WsConnection *>(reinterpret_cast<char *>(watcher) - offsetof(WsConnection, timer_watcher));
-    connection->timer();
-}
-
 void WsConnection::stopReadHandler() {
     println("{}:{}: {}", __FILE__, __LINE__, __PRETTY_FUNCTION__);
     if (!ev_is_active(&read_watcher)) {
@@ -427,23 +420,20 @@ void WsConnection::startWriteHandler() {
 
 void WsConnection::startTimer() {
     println("{}:{}: {}", __FILE__, __LINE__, __PRETTY_FUNCTION__);
-    if (timer_active) {
+    if (connectTimer.armed()) {
         return;
     }
     println("startTimer");
-    timer_active = true;
-    ev_timer_init(&timer_watcher, libev_timer_cb, 1, 0.);
-    ev_timer_start(protocol->loop, &timer_watcher);
+    timers().start(connectTimer, 1);
 }
 
 void WsConnection::stopTimer() {
     println("{}:{}: {}", __FILE__, __LINE__, __PRETTY_FUNCTION__);
-    if (!timer_active) {
+    if (!connectTimer.armed()) {
         return;
     }
     println("stopTimer");
-    timer_active = false;
-    ev_timer_stop(protocol->loop, &timer_watcher);
+    connectTimer.cancel();
 }
 void WsConnection::timer() {
     println("{}:{}: {}", __FILE__, __LINE__, __PRETTY_FUNCTION__);
@@ -454,9 +444,7 @@ void WsConnection::timer() {
         ::close(fd);
         fd = -1;
         state = ConnectionState::IDLE;
-        while (!interlock.empty()) {
-            interlock.resume(interlock.begin()->first, make_exception_ptr(TIMEOUT(0, CORBA::CompletionStatus::NO)));
-        }
+        outstanding.resumeAll(make_exception_ptr(TIMEOUT(0, CORBA::CompletionStatus::NO)));
     }
 }
 
@@ -26,11 +26,12 @@ class WsConnection : public Connection {
         int fd = -1;
         ev_io read_watcher;
         ev_io write_watcher;
-        ev_timer timer_watcher;
-        bool timer_active:1 = false;
+        /**
+         * gives up connecting after a while
+         */
+        TimerWheel::Timer connectTimer;
         static void libev_read_cb(struct ev_loop *loop, struct ev_io *watcher, int revents);
         static void libev_write_cb(struct ev_loop *loop, struct ev_io *watcher, int revents);
-        static void libev_timer_cb(struct ev_loop *loop, struct ev_timer *watcher, int revents);
 
         //-------
         WsConnectionState wsstate;
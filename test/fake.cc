@@ -25,9 +25,10 @@ std::shared_ptr<CORBA::detail::Connection> FakeTcpProtocol::connectIncoming(cons
 void FakeTcpProtocol::shutdown() {}
 
 void TcpFakeConnection::up() {}
-void TcpFakeConnection::send(std::unique_ptr<std::vector<char>> &&data) {
+void TcpFakeConnection::send(std::unique_ptr<CORBA::detail::Buffer> &&data) {
     // println("TcpFakeConnection::send(...) from {}:{} to {}:{}", m_localAddress, m_localPort, m_remoteAddress, m_remotePort);
     protocol->packets.emplace_back(FakePaket(this, data->data(), data->size()));
+    bufferPool.release(std::move(data));
 }
 
 bool transmit(std::vector<FakeTcpProtocol *> &protocols) {
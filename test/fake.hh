@@ -55,7 +55,7 @@ class TcpFakeConnection : public CORBA::detail::Connection {
         uint16_t remotePort() const { return m_remotePort; }
 
         void up() override;
-        void send(std::unique_ptr<std::vector<char>> &&) override;
+        void send(std::unique_ptr<CORBA::detail::Buffer> &&) override;
 };
 
 bool transmit(std::vector<FakeTcpProtocol *> &protocols);
@@ -124,6 +124,20 @@ kaffeeklatsch_spec([] {
             expect(reply->requestId).to.equal(4);
             expect(reply->replyStatus).to.equal(CORBA::ReplyStatus::NO_EXCEPTION);
         });
+        it("readSequence() deduces the element type from the callback", [] {
+            CORBA::GIOPEncoder encoder;
+            std::vector<uint32_t> values{1, 2, 3};
+            encoder.writeSequence(values, [&](uint32_t value) { encoder.writeUlong(value); });
+            encoder.writeSequence(values, [&](uint32_t value) { encoder.writeUlong(value); });
+            encoder.writeSequence(values, [&](uint32_t value) { encoder.writeUlong(value); });
+
+            CORBA::CDRDecoder cdr(encoder.buffer.data(), encoder.buffer.offset);
+            CORBA::GIOPDecoder decoder(cdr);
+            std::function<uint32_t()> readElement = [&] { return decoder.readUlong(); };
+            expect(decoder.readSequence(readElement)).equals(values);
+            expect(decoder.readSequence([&] { return decoder.readUlong(); })).equals(values);
+            expect(decoder.readSequence<uint32_t>([&] { return decoder.readUlong(); })).equals(values);
+        });
         describe("decode/encode null object reference", [] {
             it("OmniORB: decode sequence<VideoCamera> of [undefined, object]", [] {
                 auto data = parseOmniDump(R"(
@@ -99,8 +99,8 @@ using namespace kaffeeklatsch;
 using namespace CORBA;
 using namespace CORBA::detail;
 
-unique_ptr<vector<char>> str2vec(const char *data) {
-    auto vec = make_unique<vector<char>>();
+unique_ptr<Buffer> str2vec(const char *data) {
+    auto vec = make_unique<Buffer>();
     vec->assign(data, data + strlen(data));
     return vec;
 }
@@ -250,6 +250,78 @@ kaffeeklatsch_spec([] {
                 auto m3 = s2p.message();
                 expect(m3.empty()).to.beTrue();
             });
+            it("grows to the announced message size in one step and shrinks afterwards", [] {
+                CORBA::GIOPEncoder encoder;
+                encoder.encodeRequest(CORBA::blob("1234"), "operation", 0, false);
+                string s(4096, 'a');
+                encoder.writeString(s);
+                encoder.setGIOPHeader(CORBA::MessageType::REQUEST);
+
+                IIOPStream2Packet s2p(512);
+                memcpy(s2p.buffer(), encoder.buffer.data(), 16);
+                s2p.received(16);
+                expect(s2p.message().empty()).to.beTrue();
+
+                memcpy(s2p.buffer(), encoder.buffer.data() + 16, encoder.buffer.length() - 16);
+                expect(s2p.bufferBytes()).to.equal(encoder.buffer.length());
+                s2p.received(encoder.buffer.length() - 16);
+                expect(span(encoder.buffer.data(), encoder.buffer.length())).to.equal(s2p.message());
+
+                s2p.buffer();
+                expect(s2p.bufferBytes()).to.equal(512);
+            });
+            it("buffers() reads the rest of a message and the following data into separate buffers", [] {
+                CORBA::GIOPEncoder encoder;
+                encoder.encodeRequest(CORBA::blob("1234"), "operation", 0, false);
+                string s(19, 'a');
+                encoder.writeString(s);
+                encoder.setGIOPHeader(CORBA::MessageType::REQUEST);
+                auto length = encoder.buffer.length();
+
+                IIOPStream2Packet s2p(512);
+                struct iovec iov[2];
+                expect(s2p.buffers(iov)).to.equal(1);
+                memcpy(iov[0].iov_base, encoder.buffer.data(), 16);
+                s2p.received(16);
+                expect(s2p.message().empty()).to.beTrue();
+
+                // WHEN the rest of the 1st and a 2nd message are received by readv()
+                expect(s2p.buffers(iov)).to.equal(2);
+                expect(iov[0].iov_len).to.equal(length - 16);
+                memcpy(iov[0].iov_base, encoder.buffer.data() + 16, length - 16);
+                memcpy(iov[1].iov_base, encoder.buffer.data(), length);
+                s2p.received(length - 16 + length);
+
+                // THEN both messages are returned
+                expect(span(encoder.buffer.data(), length)).to.equal(s2p.message());
+                expect(span(encoder.buffer.data(), length)).to.equal(s2p.message());
+                expect(s2p.message().empty()).to.beTrue();
+            });
+            it("does not reuse a buffer while a message's owner is held", [] {
+                CORBA::GIOPEncoder encoder;
+                encoder.encodeRequest(CORBA::blob("1234"), "operation", 0, false);
+                string s(19, 'a');
+                encoder.writeString(s);
+                encoder.setGIOPHeader(CORBA::MessageType::REQUEST);
+                auto length = encoder.buffer.length();
+
+                IIOPStream2Packet s2p(512);
+                memcpy(s2p.buffer(), encoder.buffer.data(), length);
+                s2p.received(length);
+                auto m0 = s2p.message();
+                auto owner = s2p.owner();
+                expect(owner != nullptr).to.beTrue();
+
+                // WHEN the next message is received
+                auto buffer = s2p.buffer();
+                memset(buffer, 'x', s2p.length());
+                memcpy(buffer, encoder.buffer.data(), length);
+                s2p.received(length);
+
+                // THEN the previous message is unchanged
+                expect(span(encoder.buffer.data(), length)).to.equal(m0);
+                expect(span(encoder.buffer.data(), length)).to.equal(s2p.message());
+            });
 
             // splits two packets
         });
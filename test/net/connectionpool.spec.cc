@@ -0,0 +1,56 @@
+#include <memory>
+
+#include "../src/corba/net/connection.hh"
+#include "../src/corba/net/tcp/protocol.hh"
+#include "kaffeeklatsch.hh"
+
+using namespace kaffeeklatsch;
+using namespace std;
+using namespace CORBA::detail;
+
+class FakeConnection : public Connection {
+    public:
+        FakeConnection(Protocol *protocol, const char *host, uint16_t port) : Connection(protocol, host, port) {}
+        void up() override {}
+        void send(unique_ptr<Buffer> &&) override {}
+};
+
+kaffeeklatsch_spec([] {
+    describe("ConnectionPool", [] {
+        it("finds connections by their remote and local address", [] {
+            TcpProtocol protocol(EV_DEFAULT);
+            protocol.local = HostAndPort("localhost", 9000);
+
+            ConnectionPool pool;
+            auto a = make_shared<FakeConnection>(&protocol, "alpha", 1);
+            auto b = make_shared<FakeConnection>(&protocol, "beta", 2);
+            pool.insert(a);
+            pool.insert(b);
+
+            expect(pool.findByRemote("alpha", 1) == a).to.beTrue();
+            expect(pool.findByRemote("beta", 2) == b).to.beTrue();
+            expect(pool.findByRemote("alpha", 2) == nullptr).to.beTrue();
+            expect(pool.findByLocal("localhost", 9000) != nullptr).to.beTrue();
+            expect(pool.findByLocal("localhost", 9001) == nullptr).to.beTrue();
+
+            pool.erase(a);
+            expect(pool.findByRemote("alpha", 1) == nullptr).to.beTrue();
+            expect(pool.findByLocal("localhost", 9000) == b).to.beTrue();
+
+            pool.erase(b);
+            expect(pool.findByLocal("localhost", 9000) == nullptr).to.beTrue();
+            expect(pool.size()).to.equal(0uz);
+        });
+        it("follows a change of the remote address", [] {
+            ConnectionPool pool;
+            auto a = make_shared<FakeConnection>(nullptr, "alpha", 1);
+            pool.insert(a);
+
+            // e.g. the listening address announced via BiDir IIOP
+            a->setRemote("gamma", 3);
+            expect(pool.findByRemote("alpha", 1) == nullptr).to.beTrue();
+            expect(pool.findByRemote("gamma", 3) == a).to.beTrue();
+            pool.clear();
+        });
+    });
+});
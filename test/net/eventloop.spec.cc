@@ -0,0 +1,52 @@
+#include <future>
+
+#include "../src/corba/net/eventloop.hh"
+#include "kaffeeklatsch.hh"
+
+using namespace kaffeeklatsch;
+using namespace std;
+using namespace CORBA::detail;
+
+static void libev_timeout_cb(struct ev_loop *loop, ev_timer *watcher, int revents) { ev_break(loop); }
+
+kaffeeklatsch_spec([] {
+    describe("EventLoop", [] {
+        it("runs posted tasks on the worker's thread", [] {
+            auto home = make_shared<EventLoop>(EV_DEFAULT);
+            auto worker = make_shared<EventLoop>(home.get());
+            worker->start();
+
+            expect(home->isCurrent()).to.beTrue();
+            expect(worker->isCurrent()).to.equal(false);
+
+            promise<bool> ranOnWorker;
+            worker->post([&] { ranOnWorker.set_value(worker->isCurrent() && EventLoop::current() == worker.get() && !home->isCurrent()); });
+            expect(ranOnWorker.get_future().get()).to.beTrue();
+
+            worker->stop();
+        });
+        it("runs tasks posted to the home loop within ev_run()", [] {
+            struct ev_loop *loop = EV_DEFAULT;
+            auto home = make_shared<EventLoop>(loop);
+            auto worker = make_shared<EventLoop>(home.get());
+            worker->start();
+
+            bool ranOnHome = false;
+            worker->post([&] {
+                home->post([&] {
+                    ranOnHome = home->isCurrent();
+                    ev_break(loop);
+                });
+            });
+            // keep ev_run() alive until the task arrives as the home loop's async watcher is unref'd
+            ev_timer timeout;
+            ev_timer_init(&timeout, libev_timeout_cb, 5, 0);
+            ev_timer_start(loop, &timeout);
+            ev_run(loop, 0);
+            ev_timer_stop(loop, &timeout);
+
+            expect(ranOnHome).to.beTrue();
+            worker->stop();
+        });
+    });
+});
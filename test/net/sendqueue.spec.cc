@@ -0,0 +1,75 @@
+#include <cstring>
+#include <string>
+
+#include "../src/corba/net/sendqueue.hh"
+#include "kaffeeklatsch.hh"
+
+using namespace kaffeeklatsch;
+using namespace std;
+using namespace CORBA::detail;
+
+static unique_ptr<Buffer> str2buf(BufferPool &pool, const char *data) {
+    auto buffer = pool.acquire();
+    buffer->resize(strlen(data));
+    memcpy(buffer->data(), data, buffer->size());
+    return buffer;
+}
+
+/**
+ * write at most nbytes of what gather() provides into out
+ */
+static size_t write(SendQueue &queue, BufferPool &pool, string &out, size_t nbytes, size_t iovmax = 1024) {
+    struct iovec iov[1024];
+    size_t total;
+    auto iovcnt = queue.gather(iov, iovmax, &total);
+    auto n = min(nbytes, total);
+    auto left = n;
+    for (size_t i = 0; i < iovcnt && left > 0; ++i) {
+        auto k = min(left, iov[i].iov_len);
+        out.append(static_cast<char *>(iov[i].iov_base), k);
+        left -= k;
+    }
+    queue.consume(n, pool);
+    return n;
+}
+
+kaffeeklatsch_spec([] {
+    describe("SendQueue", [] {
+        it("gathers all queued messages and their segments", [] {
+            BufferPool pool;
+            SendQueue queue;
+            const char *segment = "-segment-";
+            queue.push(str2buf(pool, "first"), {});
+            queue.push(str2buf(pool, "second"), {{3, segment, strlen(segment)}});
+            queue.push(str2buf(pool, "third"), {});
+
+            string out;
+            write(queue, pool, out, 1000);
+
+            expect(out).to.equal("firstsec-segment-ondthird");
+            expect(queue.empty()).beTrue();
+            expect(pool.size()).equals(3);
+        });
+        it("continues partial writes within messages and segments", [] {
+            BufferPool pool;
+            SendQueue queue;
+            const char *segment = "-segment-";
+            string expected;
+            for (int i = 0; i < 20; ++i) {
+                if (i % 3 == 0) {
+                    queue.push(str2buf(pool, "ABCD"), {{2, segment, strlen(segment)}});
+                    expected += "AB-segment-CD";
+                } else {
+                    queue.push(str2buf(pool, "ABCD"), {});
+                    expected += "ABCD";
+                }
+            }
+
+            string out;
+            while (!queue.empty()) {
+                write(queue, pool, out, 5, 3);
+            }
+            expect(out).to.equal(expected);
+        });
+    });
+});
@@ -11,7 +11,12 @@
 #include <unistd.h>
 #include <cstddef>
 
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstring>
 #include <fstream>
+#include <thread>
 
 #include "../interface/interface_impl.hh"
 #include "../interface/interface_skel.hh"
@@ -38,6 +43,48 @@ std::string readString(const char *filename) {
 void libev_read_cb(struct ev_loop *loop, struct ev_io *watcher, int revents) {
 }
 
+/**
+ * remembers the thread callLong() was called on
+ */
+class ThreadRecorder : public Interface_impl {
+    public:
+        std::thread::id thread;
+        ThreadRecorder(shared_ptr<CORBA::ORB> orb) : Interface_impl(orb) {}
+        CORBA::async<int32_t> callLong(int32_t value) override {
+            thread = this_thread::get_id();
+            co_return value;
+        }
+};
+
+/**
+ * takes half a second to answer callLong()
+ */
+class SlowBackend : public Interface_impl {
+    public:
+        SlowBackend(shared_ptr<CORBA::ORB> orb) : Interface_impl(orb) {}
+        CORBA::async<int32_t> callLong(int32_t value) override {
+            this_thread::sleep_for(500ms);
+            co_return value;
+        }
+};
+
+/**
+ * forwards callLong() to backend and remembers the threads it ran on before
+ * and after the call
+ */
+class Relay : public Interface_impl {
+    public:
+        shared_ptr<Interface> backend;
+        std::thread::id called, resumed;
+        Relay(shared_ptr<CORBA::ORB> orb) : Interface_impl(orb) {}
+        CORBA::async<int32_t> callLong(int32_t value) override {
+            called = this_thread::get_id();
+            auto result = co_await backend->callLong(value);
+            resumed = this_thread::get_id();
+            co_return result;
+        }
+};
+
 kaffeeklatsch_spec([] {
     describe("net", [] {
         describe("tcp", [] {
@@ -105,6 +152,700 @@ kaffeeklatsch_spec([] {
                 // expect(clientConn->localAddress()).to.equal(serverConn->remoteAddress());
                 // expect(clientConn->localPort()).to.equal(serverConn->remotePort());
             });
+            it("serves incoming connections on worker loops", [] {
+                struct ev_loop *loop = EV_DEFAULT;
+
+                auto serverORB = make_shared<CORBA::ORB>("server");
+                auto serverProto = new CORBA::detail::TcpProtocol(loop);
+                serverProto->threads = 3;
+                serverORB->registerProtocol(serverProto);
+                serverProto->listen("127.0.0.1", 9004);
+
+                auto backend = make_shared<Interface_impl>(serverORB);
+                serverORB->bind("Backend", backend);
+                auto local = make_shared<Interface_impl>(serverORB);
+                local->loopLocal = true;
+                serverORB->bind("Local", local);
+
+                vector<shared_ptr<CORBA::ORB>> clientORBs;
+                for (int i = 0; i < 3; ++i) {
+                    clientORBs.push_back(make_shared<CORBA::ORB>("client"));
+                    clientORBs.back()->registerProtocol(new CORBA::detail::TcpProtocol(loop));
+                }
+
+                std::exception_ptr eptr;
+                parallel(eptr, loop, [clientORBs] -> async<> {
+                    for (auto &clientORB : clientORBs) {
+                        auto backend = Interface::_narrow(co_await clientORB->stringToObject("corbaname::127.0.0.1:9004#Backend"));
+                        expect(co_await backend->callString("home")).to.equal("home");
+                        auto local = Interface::_narrow(co_await clientORB->stringToObject("corbaname::127.0.0.1:9004#Local"));
+                        expect(co_await local->callString("worker")).to.equal("worker");
+                    }
+                });
+                ev_run(loop, 0);
+                if (eptr) {
+                    std::rethrow_exception(eptr);
+                }
+                expect(serverORB->connections.size()).to.equal(3uz);
+            });
+            it("accepts incoming connections on a listen socket per loop", [] {
+                struct ev_loop *loop = EV_DEFAULT;
+
+                auto serverORB = make_shared<CORBA::ORB>("server");
+                auto serverProto = new CORBA::detail::TcpProtocol(loop);
+                serverProto->threads = 2;
+                serverProto->reusePort = true;
+                serverProto->backlog = 128;
+                serverORB->registerProtocol(serverProto);
+                serverProto->listen("127.0.0.1", 9005);
+
+                auto backend = make_shared<Interface_impl>(serverORB);
+                serverORB->bind("Backend", backend);
+
+                vector<shared_ptr<CORBA::ORB>> clientORBs;
+                for (int i = 0; i < 4; ++i) {
+                    clientORBs.push_back(make_shared<CORBA::ORB>("client"));
+                    clientORBs.back()->registerProtocol(new CORBA::detail::TcpProtocol(loop));
+                }
+
+                std::exception_ptr eptr;
+                parallel(eptr, loop, [clientORBs] -> async<> {
+                    for (auto &clientORB : clientORBs) {
+                        auto backend = Interface::_narrow(co_await clientORB->stringToObject("corbaname::127.0.0.1:9005#Backend"));
+                        expect(co_await backend->callString("hello")).to.equal("hello");
+                    }
+                });
+                ev_run(loop, 0);
+                if (eptr) {
+                    std::rethrow_exception(eptr);
+                }
+                expect(serverORB->connections.size()).to.equal(4uz);
+            });
+            it("runs servants on the ORB's thread pool", [] {
+                struct ev_loop *loop = EV_DEFAULT;
+
+                auto serverORB = make_shared<CORBA::ORB>("server");
+                auto serverProto = new CORBA::detail::TcpProtocol(loop);
+                serverORB->registerProtocol(serverProto);
+                serverProto->listen("127.0.0.1", 9006);
+                serverORB->threadPool.threads = 2;
+
+                auto pool = make_shared<ThreadRecorder>(serverORB);
+                pool->threadPolicy = CORBA::ThreadPolicy::THREAD_POOL;
+                serverORB->bind("Pool", pool);
+                auto serial = make_shared<ThreadRecorder>(serverORB);
+                serial->threadPolicy = CORBA::ThreadPolicy::PER_CONNECTION_SERIAL;
+                serverORB->bind("Serial", serial);
+                auto inline_ = make_shared<ThreadRecorder>(serverORB);
+                serverORB->bind("Inline", inline_);
+
+                auto clientORB = make_shared<CORBA::ORB>("client");
+                clientORB->registerProtocol(new CORBA::detail::TcpProtocol(loop));
+
+                std::exception_ptr eptr;
+                parallel(eptr, loop, [clientORB] -> async<> {
+                    for (auto name : {"Pool", "Serial", "Inline"}) {
+                        auto object = Interface::_narrow(co_await clientORB->stringToObject(format("corbaname::127.0.0.1:9006#{}", name)));
+                        for (int32_t i = 0; i < 10; ++i) {
+                            expect(co_await object->callLong(i)).to.equal(i);
+                        }
+                    }
+                });
+                ev_run(loop, 0);
+                if (eptr) {
+                    std::rethrow_exception(eptr);
+                }
+                expect(pool->thread != this_thread::get_id()).to.beTrue();
+                expect(serial->thread != this_thread::get_id()).to.beTrue();
+                expect(inline_->thread == this_thread::get_id()).to.beTrue();
+            });
+            it("lets servants on the ORB's thread pool make twoway calls", [] {
+                struct ev_loop *loop = EV_DEFAULT;
+
+                auto serverORB = make_shared<CORBA::ORB>("server");
+                auto serverProto = new CORBA::detail::TcpProtocol(loop);
+                serverORB->registerProtocol(serverProto);
+                serverProto->listen("127.0.0.1", 9019);
+                serverORB->threadPool.threads = 2;
+
+                auto backendORB = make_shared<CORBA::ORB>("backend");
+                auto backendProto = new CORBA::detail::TcpProtocol(loop);
+                backendORB->registerProtocol(backendProto);
+                backendProto->listen("127.0.0.1", 9020);
+                backendORB->bind("Backend", make_shared<Interface_impl>(backendORB));
+
+                auto relay = make_shared<Relay>(serverORB);
+                relay->threadPolicy = CORBA::ThreadPolicy::THREAD_POOL;
+                serverORB->bind("Relay", relay);
+
+                auto clientORB = make_shared<CORBA::ORB>("client");
+                clientORB->registerProtocol(new CORBA::detail::TcpProtocol(loop));
+
+                std::exception_ptr eptr;
+                parallel(eptr, loop, [clientORB, serverORB, relay] -> async<> {
+                    // the connection to the backend belongs to the home loop
+                    relay->backend = Interface::_narrow(co_await serverORB->stringToObject("corbaname::127.0.0.1:9020#Backend"));
+                    auto object = Interface::_narrow(co_await clientORB->stringToObject("corbaname::127.0.0.1:9019#Relay"));
+                    for (int32_t i = 0; i < 10; ++i) {
+                        expect(co_await object->callLong(i)).to.equal(i);
+                    }
+                });
+                ev_run(loop, 0);
+                if (eptr) {
+                    std::rethrow_exception(eptr);
+                }
+                // the reply resumes the relay on the thread pool, not the loop owning the connection
+                expect(relay->called != this_thread::get_id()).to.beTrue();
+                expect(relay->resumed != this_thread::get_id()).to.beTrue();
+            });
+            it("throws TIMEOUT when the reply does not arrive within the roundtrip timeout", [] {
+                struct ev_loop *loop = EV_DEFAULT;
+
+                auto serverORB = make_shared<CORBA::ORB>("server");
+                auto serverProto = new CORBA::detail::TcpProtocol(loop);
+                serverORB->registerProtocol(serverProto);
+                serverProto->listen("127.0.0.1", 9007);
+
+                // run on the thread pool so that the server's loop keeps going
+                auto slow = make_shared<SlowBackend>(serverORB);
+                slow->threadPolicy = CORBA::ThreadPolicy::THREAD_POOL;
+                serverORB->bind("Slow", slow);
+
+                auto clientORB = make_shared<CORBA::ORB>("client");
+                clientORB->registerProtocol(new CORBA::detail::TcpProtocol(loop));
+
+                std::exception_ptr eptr;
+                parallel(eptr, loop, [clientORB] -> async<> {
+                    auto slow = Interface::_narrow(co_await clientORB->stringToObject("corbaname::127.0.0.1:9007#Slow"));
+
+                    bool timedOut = false;
+                    try {
+                        co_await CORBA::withRoundtripTimeout(100ms, [&] { return slow->callLong(1); });
+                    } catch (CORBA::TIMEOUT &ex) {
+                        timedOut = ex.completed == CORBA::CompletionStatus::MAYBE;
+                    }
+                    expect(timedOut).to.beTrue();
+
+                    // the late reply to the first call is dropped
+                    clientORB->roundtripTimeout = 2000ms;
+                    expect(co_await slow->callLong(2)).to.equal(2);
+                });
+                ev_run(loop, 0);
+                if (eptr) {
+                    std::rethrow_exception(eptr);
+                }
+            });
+            it("copies the caller's memory still queued for a request when it times out", [] {
+                struct ev_loop *loop = EV_DEFAULT;
+
+                // a peer which does not read until told so
+                int listener = socket(AF_INET, SOCK_STREAM, 0);
+                int on = 1;
+                setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+                sockaddr_in addr{};
+                addr.sin_family = AF_INET;
+                addr.sin_port = htons(9016);
+                addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+                expect(::bind(listener, (sockaddr *)&addr, sizeof(addr))).to.equal(0);
+                expect(::listen(listener, 1)).to.equal(0);
+
+                std::atomic_bool startReading = false, done = false;
+                vector<char> received;
+                std::thread peer([&] {
+                    while (!startReading) {
+                        this_thread::sleep_for(10ms);
+                    }
+                    int fd = ::accept(listener, nullptr, nullptr);
+                    auto readAll = [fd](char *data, size_t size) {
+                        while (size > 0) {
+                            auto n = ::read(fd, data, size);
+                            if (n <= 0) {
+                                return false;
+                            }
+                            data += n;
+                            size -= n;
+                        }
+                        return true;
+                    };
+                    received.resize(12);
+                    if (readAll(received.data(), 12)) {
+                        uint32_t length;
+                        memcpy(&length, received.data() + 8, 4);
+                        if (static_cast<bool>(received[6] & 1) != (std::endian::native == std::endian::little)) {
+                            length = std::byteswap(length);
+                        }
+                        received.resize(12 + length);
+                        readAll(received.data() + 12, length);
+                    }
+                    ::close(fd);
+                    done = true;
+                });
+
+                auto clientORB = make_shared<CORBA::ORB>("client");
+                clientORB->registerProtocol(new CORBA::detail::TcpProtocol(loop));
+                auto stub = make_shared<CORBA::Stub>();
+                stub->initStub(clientORB, CORBA::blob("Backend"), clientORB->getConnection("127.0.0.1", 9016));
+
+                // more than the socket buffers hold, hence the request remains queued
+                const size_t size = 32 * 1024 * 1024;
+                auto payload = make_unique<vector<char>>(size, 'p');
+
+                std::exception_ptr eptr;
+                parallel(eptr, loop, [clientORB, stub, &payload] -> async<> {
+                    bool timedOut = false;
+                    try {
+                        co_await CORBA::withRoundtripTimeout(100ms, [&] {
+                            return clientORB->twowayCall(stub.get(), "callBlob", [&](CORBA::GIOPEncoder &encoder) {
+                                encoder.writeBlobView(payload->data(), payload->size());
+                            });
+                        });
+                    } catch (CORBA::TIMEOUT &) {
+                        timedOut = true;
+                    }
+                    expect(timedOut).to.beTrue();
+                    // the caller's memory is gone
+                    fill(payload->begin(), payload->end(), 'x');
+                    payload.reset();
+                });
+                ev_run(loop, 0);
+                if (eptr) {
+                    std::rethrow_exception(eptr);
+                }
+
+                // let the peer read the request
+                startReading = true;
+                while (!done) {
+                    ev_run(loop, EVRUN_NOWAIT);
+                    this_thread::sleep_for(1ms);
+                }
+                peer.join();
+                ::close(listener);
+
+                expect(received.size() > size).to.beTrue();
+                expect(all_of(received.end() - size, received.end(), [](char c) { return c == 'p'; })).to.beTrue();
+            });
+            it("closes idle and least recently used connections", [] {
+                struct ev_loop *loop = EV_DEFAULT;
+
+                vector<shared_ptr<CORBA::ORB>> serverORBs;
+                for (unsigned port : {9008, 9009}) {
+                    serverORBs.push_back(make_shared<CORBA::ORB>("server"));
+                    auto serverProto = new CORBA::detail::TcpProtocol(loop);
+                    serverORBs.back()->registerProtocol(serverProto);
+                    serverProto->listen("127.0.0.1", port);
+                    serverORBs.back()->bind("Backend", make_shared<Interface_impl>(serverORBs.back()));
+                }
+
+                auto clientORB = make_shared<CORBA::ORB>("client");
+                clientORB->registerProtocol(new CORBA::detail::TcpProtocol(loop));
+                clientORB->connections.maxConnections = 1;
+                clientORB->connections.idleTimeout = 100ms;
+
+                std::exception_ptr eptr;
+                shared_ptr<Interface> first, second;
+                parallel(eptr, loop, [clientORB, &first, &second] -> async<> {
+                    first = Interface::_narrow(co_await clientORB->stringToObject("corbaname::127.0.0.1:9008#Backend"));
+                    expect(co_await first->callString("first")).to.equal("first");
+
+                    // the connection to the 2nd server evicts the one to the 1st
+                    second = Interface::_narrow(co_await clientORB->stringToObject("corbaname::127.0.0.1:9009#Backend"));
+                    expect(co_await second->callString("second")).to.equal("second");
+                    auto stats = clientORB->connections.stats();
+                    expect(stats.open).to.equal(1uz);
+                    expect(stats.idle).to.equal(1uz);
+                    expect(stats.inUse).to.equal(0uz);
+                    expect(stats.evicted).to.equal(1uz);
+
+                    // which is reopened by the next call
+                    expect(co_await first->callString("again")).to.equal("again");
+                    expect(clientORB->connections.stats().open).to.equal(2uz);
+                });
+                ev_run(loop, 0);
+                if (eptr) {
+                    std::rethrow_exception(eptr);
+                }
+
+                // give the idle timeout a chance to close both connections
+                CORBA::detail::TimerWheel::Timer wait([loop] { ev_break(loop); });
+                CORBA::detail::TimerWheel::of(loop).start(wait, 0.5);
+                ev_run(loop, 0);
+
+                auto stats = clientORB->connections.stats();
+                expect(stats.open).to.equal(0uz);
+                expect(stats.evicted).to.equal(3uz);
+            });
+            it("does not close a connection while a servant is still serving a request", [] {
+                struct ev_loop *loop = EV_DEFAULT;
+
+                auto serverORB = make_shared<CORBA::ORB>("server");
+                auto serverProto = new CORBA::detail::TcpProtocol(loop);
+                serverORB->registerProtocol(serverProto);
+                serverProto->listen("127.0.0.1", 9015);
+                serverORB->connections.idleTimeout = 100ms;
+
+                // takes longer than the idle timeout
+                auto slow = make_shared<SlowBackend>(serverORB);
+                slow->threadPolicy = CORBA::ThreadPolicy::THREAD_POOL;
+                serverORB->bind("Slow", slow);
+
+                auto clientORB = make_shared<CORBA::ORB>("client");
+                clientORB->registerProtocol(new CORBA::detail::TcpProtocol(loop));
+
+                std::exception_ptr eptr;
+                parallel(eptr, loop, [clientORB, serverORB] -> async<> {
+                    auto slow = Interface::_narrow(co_await clientORB->stringToObject("corbaname::127.0.0.1:9015#Slow"));
+                    expect(co_await slow->callLong(1)).to.equal(1);
+                    expect(serverORB->connections.stats().evicted).to.equal(0uz);
+                });
+                ev_run(loop, 0);
+                if (eptr) {
+                    std::rethrow_exception(eptr);
+                }
+            });
+            it("spreads calls over several connections to a peer", [] {
+                struct ev_loop *loop = EV_DEFAULT;
+
+                auto serverORB = make_shared<CORBA::ORB>("server");
+                auto serverProto = new CORBA::detail::TcpProtocol(loop);
+                serverORB->registerProtocol(serverProto);
+                serverProto->listen("127.0.0.1", 9010);
+
+                auto slow = make_shared<SlowBackend>(serverORB);
+                slow->threadPolicy = CORBA::ThreadPolicy::THREAD_POOL;
+                serverORB->bind("Slow", slow);
+
+                auto clientORB = make_shared<CORBA::ORB>("client");
+                clientORB->registerProtocol(new CORBA::detail::TcpProtocol(loop));
+                clientORB->connectionsPerPeer = 3;
+
+                std::exception_ptr eptr;
+                shared_ptr<Interface> backend;
+                parallel(eptr, loop, [clientORB, &backend] -> async<> {
+                    backend = Interface::_narrow(co_await clientORB->stringToObject("corbaname::127.0.0.1:9010#Slow"));
+                });
+                ev_run(loop, 0);
+                if (eptr) {
+                    std::rethrow_exception(eptr);
+                }
+                expect(clientORB->connections.size()).to.equal(1uz);
+
+                // while the connections are busy, each call opens another one
+                int done = 0;
+                for (int32_t i = 0; i < 3; ++i) {
+                    parallel(eptr, [backend, i, &done, loop] -> async<> {
+                        expect(co_await backend->callLong(i)).to.equal(i);
+                        if (++done == 3) {
+                            ev_break(loop);
+                        }
+                    });
+                }
+                ev_run(loop, 0);
+                if (eptr) {
+                    std::rethrow_exception(eptr);
+                }
+                expect(clientORB->connections.size()).to.equal(3uz);
+
+                // bulk calls get a connection of their own
+                dynamic_pointer_cast<CORBA::Stub>(backend)->bulk = true;
+                parallel(eptr, loop, [backend] -> async<> {
+                    expect(co_await backend->callLong(4)).to.equal(4);
+                });
+                ev_run(loop, 0);
+                if (eptr) {
+                    std::rethrow_exception(eptr);
+                }
+                expect(clientORB->connections.size()).to.equal(4uz);
+            });
+            it("estimates the size of a request from the operation's previous one", [] {
+                struct ev_loop *loop = EV_DEFAULT;
+
+                auto serverORB = make_shared<CORBA::ORB>("server");
+                auto serverProto = new CORBA::detail::TcpProtocol(loop);
+                serverORB->registerProtocol(serverProto);
+                serverProto->listen("127.0.0.1", 9013);
+                serverORB->bind("Backend", make_shared<Interface_impl>(serverORB));
+
+                auto clientORB = make_shared<CORBA::ORB>("client");
+                clientORB->registerProtocol(new CORBA::detail::TcpProtocol(loop));
+                clientORB->bulkThreshold = 4096;
+
+                std::exception_ptr eptr;
+                parallel(eptr, loop, [clientORB] -> async<> {
+                    auto backend = Interface::_narrow(co_await clientORB->stringToObject("corbaname::127.0.0.1:9013#Backend"));
+                    auto stub = dynamic_pointer_cast<CORBA::Stub>(backend);
+                    expect(stub->lastRequestSize("callString").size).to.equal(0uz);
+
+                    string large(8192, 'x');
+                    expect(co_await backend->callString(large)).to.equal(large);
+                    expect(stub->lastRequestSize("callString").size > large.size()).to.beTrue();
+                    expect(clientORB->connections.size()).to.equal(1uz);
+
+                    // the estimate now exceeds the bulk threshold
+                    expect(co_await backend->callString(large)).to.equal(large);
+                    expect(clientORB->connections.size()).to.equal(2uz);
+
+                    // the caller's memory referenced by a request is not reserved for the next one
+                    string payload(65536, 'p');
+                    co_await clientORB->twowayCall(stub.get(), "callBlob", [&](CORBA::GIOPEncoder &encoder) {
+                        encoder.writeBlobView(payload.data(), payload.size());
+                    });
+                    auto last = stub->lastRequestSize("callBlob");
+                    expect(last.size > payload.size()).to.beTrue();
+                    expect(last.length < 4096).to.beTrue();
+                });
+                ev_run(loop, 0);
+                if (eptr) {
+                    std::rethrow_exception(eptr);
+                }
+            });
+            it("keeps the calls of a stub in order after a oneway call", [] {
+                struct ev_loop *loop = EV_DEFAULT;
+
+                struct Recorder : public Interface_impl {
+                        vector<string> calls;
+                        Recorder(shared_ptr<CORBA::ORB> orb) : Interface_impl(orb) {}
+                        void recvString(const string_view &value) override { calls.push_back(string(value.substr(0, 8))); }
+                        CORBA::async<string> callString(const string_view &value) override {
+                            calls.push_back(string(value));
+                            co_return string(value);
+                        }
+                };
+
+                auto serverORB = make_shared<CORBA::ORB>("server");
+                auto serverProto = new CORBA::detail::TcpProtocol(loop);
+                serverORB->registerProtocol(serverProto);
+                serverProto->listen("127.0.0.1", 9014);
+                auto recorder = make_shared<Recorder>(serverORB);
+                serverORB->bind("Backend", recorder);
+
+                auto clientORB = make_shared<CORBA::ORB>("client");
+                clientORB->registerProtocol(new CORBA::detail::TcpProtocol(loop));
+                clientORB->connectionsPerPeer = 3;
+                clientORB->bulkThreshold = 4096;
+
+                std::exception_ptr eptr;
+                parallel(eptr, loop, [clientORB] -> async<> {
+                    auto backend = Interface::_narrow(co_await clientORB->stringToObject("corbaname::127.0.0.1:9014#Backend"));
+                    for (int i = 0; i < 6; ++i) {
+                        // every other one exceeds the bulk threshold
+                        auto value = format("{:08}", i);
+                        if (i & 1) {
+                            value += string(8192, 'x');
+                        }
+                        backend->recvString(value);
+                    }
+                    expect(co_await backend->callString("last")).to.equal("last");
+                });
+                ev_run(loop, 0);
+                if (eptr) {
+                    std::rethrow_exception(eptr);
+                }
+                expect(recorder->calls).to.equal(vector<string>{"00000000", "00000001", "00000002", "00000003", "00000004", "00000005", "last"});
+                expect(clientORB->connections.size()).to.equal(1uz);
+            });
+            it("sends large messages as GIOP 1.2 fragments", [] {
+                struct ev_loop *loop = EV_DEFAULT;
+
+                auto serverORB = make_shared<CORBA::ORB>("server");
+                auto serverProto = new CORBA::detail::TcpProtocol(loop);
+                serverProto->fragmentSize = 256;
+                serverORB->registerProtocol(serverProto);
+                serverProto->listen("127.0.0.1", 9011);
+
+                auto backend = make_shared<Interface_impl>(serverORB);
+                serverORB->bind("Backend", backend);
+
+                auto clientORB = make_shared<CORBA::ORB>("client");
+                auto clientProto = new CORBA::detail::TcpProtocol(loop);
+                clientProto->fragmentSize = 256;
+                clientORB->registerProtocol(clientProto);
+
+                std::exception_ptr eptr;
+                parallel(eptr, loop, [clientORB] -> async<> {
+                    auto backend = Interface::_narrow(co_await clientORB->stringToObject("corbaname::127.0.0.1:9011#Backend"));
+                    string large;
+                    for (int i = 0; i < 1000; ++i) {
+                        large += format("{:04} ", i);
+                    }
+                    expect(co_await backend->callString(large)).to.equal(large);
+                    expect(co_await backend->callString("small")).to.equal("small");
+                });
+                ev_run(loop, 0);
+                if (eptr) {
+                    std::rethrow_exception(eptr);
+                }
+            });
+            it("sends CloseConnection after the last fragment of a message", [] {
+                struct ev_loop *loop = EV_DEFAULT;
+
+                struct Recorder : public Interface_impl {
+                        size_t received = 0;
+                        Recorder(std::shared_ptr<CORBA::ORB> orb) : Interface_impl(orb) {}
+                        void recvString(const string_view &value) override { received = value.size(); }
+                };
+
+                auto serverORB = make_shared<CORBA::ORB>("server");
+                auto serverProto = new CORBA::detail::TcpProtocol(loop);
+                serverORB->registerProtocol(serverProto);
+                serverProto->listen("127.0.0.1", 9017);
+                auto recorder = make_shared<Recorder>(serverORB);
+                serverORB->bind("Backend", recorder);
+
+                auto clientORB = make_shared<CORBA::ORB>("client");
+                auto clientProto = new CORBA::detail::TcpProtocol(loop);
+                clientProto->fragmentSize = 65536;
+                clientORB->registerProtocol(clientProto);
+
+                // more than the socket buffers hold, hence fragments are still queued when the connection is closed
+                const size_t size = 32 * 1024 * 1024;
+                std::exception_ptr eptr;
+                parallel(eptr, loop, [clientORB] -> async<> {
+                    auto backend = Interface::_narrow(co_await clientORB->stringToObject("corbaname::127.0.0.1:9017#Backend"));
+                    expect(co_await backend->callString("hello")).to.equal("hello");
+                    backend->recvString(string(size, 'x'));
+                    clientORB->close(clientORB->connections.findByRemote("127.0.0.1", 9017).get());
+                });
+                ev_run(loop, 0);
+                if (eptr) {
+                    std::rethrow_exception(eptr);
+                }
+
+                // the remaining fragments are written before the connection is closed
+                auto deadline = chrono::steady_clock::now() + 5s;
+                while (recorder->received == 0 && chrono::steady_clock::now() < deadline) {
+                    ev_run(loop, EVRUN_NOWAIT);
+                    this_thread::sleep_for(1ms);
+                }
+                expect(recorder->received).to.equal(size);
+            });
+            it("closes a connection whose fragmented messages exceed the limits", [] {
+                struct ev_loop *loop = EV_DEFAULT;
+
+                auto serverORB = make_shared<CORBA::ORB>("server");
+                serverORB->maxFragmentedBytes = 1024;
+                auto serverProto = new CORBA::detail::TcpProtocol(loop);
+                serverORB->registerProtocol(serverProto);
+                serverProto->listen("127.0.0.1", 9018);
+
+                // a peer which starts a fragmented request but never finishes it
+                std::atomic_bool done = false;
+                vector<char> received;
+                std::thread peer([&] {
+                    auto message = [](CORBA::MessageType type, size_t payload) {
+                        vector<char> data(16 + payload, 0);
+                        memcpy(data.data(), "GIOP", 4);
+                        data[4] = 1;
+                        data[5] = 2;
+                        data[6] = (std::endian::native == std::endian::little ? 1 : 0) | 2;
+                        data[7] = static_cast<char>(type);
+                        uint32_t length = 4 + payload, requestId = 1;
+                        memcpy(data.data() + 8, &length, 4);
+                        memcpy(data.data() + 12, &requestId, 4);
+                        return data;
+                    };
+                    auto data = message(CORBA::MessageType::REQUEST, 0);
+                    for (int i = 0; i < 4; ++i) {
+                        auto fragment = message(CORBA::MessageType::FRAGMENT, 512);
+                        data.insert(data.end(), fragment.begin(), fragment.end());
+                    }
+                    int fd = socket(AF_INET, SOCK_STREAM, 0);
+                    sockaddr_in addr{};
+                    addr.sin_family = AF_INET;
+                    addr.sin_port = htons(9018);
+                    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+                    if (::connect(fd, (sockaddr *)&addr, sizeof(addr)) == 0) {
+                        ::send(fd, data.data(), data.size(), MSG_NOSIGNAL);
+                        char buffer[256];
+                        ssize_t n;
+                        while ((n = ::read(fd, buffer, sizeof(buffer))) > 0) {
+                            received.insert(received.end(), buffer, buffer + n);
+                        }
+                    }
+                    ::close(fd);
+                    done = true;
+                });
+                while (!done) {
+                    ev_run(loop, EVRUN_NOWAIT);
+                    this_thread::sleep_for(1ms);
+                }
+                peer.join();
+
+                expect(received.size() >= 12uz).to.beTrue();
+                expect(received[7]).to.equal(static_cast<char>(CORBA::MessageType::MESSAGE_ERROR));
+                expect(serverORB->connections.stats().open).to.equal(0uz);
+            });
+            it("streams the arguments of a fragmented request to the servant", [] {
+                struct ev_loop *loop = EV_DEFAULT;
+
+                struct Streaming_impl : public Interface_impl {
+                        CORBA::SequenceReader<RGBA> reader;
+                        std::vector<RGBA> pixels;
+                        size_t beforeLast = 0;
+                        size_t decoded = 0;
+                        Streaming_impl(std::shared_ptr<CORBA::ORB> orb) : Interface_impl(orb) {}
+                        CORBA::async<std::vector<RGBA>> callSeqRGBA(const std::vector<RGBA> &value) override {
+                            ++decoded;
+                            co_return value;
+                        }
+                        CORBA::async<> _streamed(const std::string_view &operation, CORBA::GIOPEncoder &encoder) override {
+                            encoder.writeSequence(pixels, [&](const RGBA &pixel) {
+                                encoder.writeOctet(pixel.r);
+                                encoder.writeOctet(pixel.g);
+                                encoder.writeOctet(pixel.b);
+                                encoder.writeOctet(pixel.a);
+                            });
+                            co_return;
+                        }
+                        std::function<void(CORBA::CDRStreamDecoder &, bool)> _stream(const std::string_view &operation) override {
+                            if (operation != "callSeqRGBA") {
+                                return {};
+                            }
+                            return [this](CORBA::CDRStreamDecoder &arguments, bool last) {
+                                reader.read(arguments, [&](std::span<const RGBA> chunk) {
+                                    pixels.insert(pixels.end(), chunk.begin(), chunk.end());
+                                    if (!last) {
+                                        beforeLast += chunk.size();
+                                    }
+                                });
+                            };
+                        }
+                };
+
+                auto serverORB = make_shared<CORBA::ORB>("server");
+                auto serverProto = new CORBA::detail::TcpProtocol(loop);
+                serverORB->registerProtocol(serverProto);
+                serverProto->listen("127.0.0.1", 9012);
+
+                auto backend = make_shared<Streaming_impl>(serverORB);
+                serverORB->bind("Backend", backend);
+
+                auto clientORB = make_shared<CORBA::ORB>("client");
+                auto clientProto = new CORBA::detail::TcpProtocol(loop);
+                clientProto->fragmentSize = 256;
+                clientORB->registerProtocol(clientProto);
+
+                std::vector<RGBA> pixels;
+                for (int i = 0; i < 2000; ++i) {
+                    pixels.push_back({uint8_t(i), uint8_t(i >> 8), uint8_t(i * 3), 255});
+                }
+                std::exception_ptr eptr;
+                parallel(eptr, loop, [clientORB, &pixels] -> async<> {
+                    auto backend = Interface::_narrow(co_await clientORB->stringToObject("corbaname::127.0.0.1:9012#Backend"));
+                    auto result = co_await backend->callSeqRGBA(pixels);
+                    expect(result.size()).to.equal(pixels.size());
+                    expect(memcmp(result.data(), pixels.data(), pixels.size() * sizeof(RGBA))).to.equal(0);
+                });
+                ev_run(loop, 0);
+                if (eptr) {
+                    std::rethrow_exception(eptr);
+                }
+                expect(backend->reader.complete()).beTrue();
+                expect(backend->pixels.size()).to.equal(pixels.size());
+                expect(memcmp(backend->pixels.data(), pixels.data(), pixels.size() * sizeof(RGBA))).to.equal(0);
+                expect(backend->beforeLast > 0).beTrue();
+                // the arguments were consumed by the stream handler only
+                expect(backend->decoded).to.equal(0uz);
+            });
             xit("call omni orb", [] {
                 struct ev_loop *loop = EV_DEFAULT;
 
@@ -0,0 +1,52 @@
+#include <chrono>
+#include <future>
+
+#include "../src/corba/net/threadpool.hh"
+#include "kaffeeklatsch.hh"
+
+using namespace kaffeeklatsch;
+using namespace std;
+using namespace CORBA::detail;
+
+kaffeeklatsch_spec([] {
+    describe("ThreadPool", [] {
+        it("runs scheduled tasks on the workers", [] {
+            ThreadPool pool;
+            pool.threads = 2;
+            pool.start(EV_DEFAULT);
+
+            promise<bool> ranOnWorker;
+            pool.schedule([&] { ranOnWorker.set_value(pool.isCurrent()); });
+            expect(ranOnWorker.get_future().get()).to.beTrue();
+            expect(pool.isCurrent()).to.equal(false);
+
+            promise<ThreadPool *> running;
+            pool.schedule([&] { running.set_value(ThreadPool::running()); });
+            expect(running.get_future().get() == &pool).to.beTrue();
+            expect(ThreadPool::running() == nullptr).to.beTrue();
+
+            pool.stop();
+        });
+        it("lets an idle worker steal tasks from a busy one", [] {
+            ThreadPool pool;
+            pool.threads = 2;
+            pool.start(EV_DEFAULT);
+
+            promise<bool> stolen;
+            promise<bool> done;
+            pool.schedule([&] {
+                // queued on this worker, which stays busy until the task has run elsewhere
+                auto thief = make_shared<promise<thread::id>>();
+                auto ranOn = thief->get_future();
+                pool.schedule([thief] { thief->set_value(this_thread::get_id()); });
+                auto ran = ranOn.wait_for(5s) == future_status::ready;
+                stolen.set_value(ran && ranOn.get() != this_thread::get_id());
+                done.set_value(true);
+            });
+            expect(stolen.get_future().get()).to.beTrue();
+            done.get_future().get();
+
+            pool.stop();
+        });
+    });
+});
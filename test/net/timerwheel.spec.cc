@@ -0,0 +1,91 @@
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "../src/corba/net/timerwheel.hh"
+#include "kaffeeklatsch.hh"
+
+using namespace kaffeeklatsch;
+using namespace std;
+using namespace CORBA::detail;
+
+kaffeeklatsch_spec([] {
+    describe("TimerWheel", [] {
+        it("fires the timers in order", [] {
+            struct ev_loop *loop = EV_DEFAULT;
+            TimerWheel wheel(loop, 0.001);
+
+            vector<int> fired;
+            TimerWheel::Timer a([&] { fired.push_back(1); });
+            TimerWheel::Timer b([&] { fired.push_back(2); });
+            // beyond the first level of the wheel
+            TimerWheel::Timer c([&] { fired.push_back(3); });
+            wheel.start(c, 0.3);
+            wheel.start(b, 0.02);
+            wheel.start(a, 0.01);
+            expect(wheel.size()).to.equal(3uz);
+
+            // the wheel's ev_timer is stopped once no timer is armed
+            ev_run(loop, 0);
+
+            expect(fired.size()).to.equal(3uz);
+            expect(fired[0]).to.equal(1);
+            expect(fired[1]).to.equal(2);
+            expect(fired[2]).to.equal(3);
+            expect(wheel.size()).to.equal(0uz);
+        });
+        it("does not fire cancelled, destroyed or restarted timers", [] {
+            struct ev_loop *loop = EV_DEFAULT;
+            TimerWheel wheel(loop, 0.001);
+
+            vector<int> fired;
+            TimerWheel::Timer a([&] { fired.push_back(1); });
+            TimerWheel::Timer b([&] { fired.push_back(2); });
+            auto c = make_unique<TimerWheel::Timer>([&] { fired.push_back(3); });
+            TimerWheel::Timer d([&] {
+                fired.push_back(4);
+                b.cancel();
+            });
+            wheel.start(a, 0.01);
+            wheel.start(b, 0.03);
+            wheel.start(*c, 0.01);
+            wheel.start(d, 0.02);
+            a.cancel();
+            c.reset();
+            // restarting moves the timer
+            wheel.start(d, 0.005);
+
+            ev_run(loop, 0);
+
+            expect(fired.size()).to.equal(1uz);
+            expect(fired[0]).to.equal(4);
+            expect(a.armed()).to.equal(false);
+            expect(b.armed()).to.equal(false);
+        });
+        it("sleeps until the next timer is due", [] {
+            struct ev_loop *loop = EV_DEFAULT;
+            TimerWheel wheel(loop, 0.001);
+
+            ev_tstamp startedB = 0, firedB = 0;
+            TimerWheel::Timer b([&] { firedB = ev_now(loop); });
+            TimerWheel::Timer c([] {});
+            wheel.start(c, 0.3);
+
+            // start a timer while the wheel is sleeping
+            std::function<void()> later = [&] {
+                startedB = ev_now(loop);
+                wheel.start(b, 0.05);
+            };
+            ev_timer watcher;
+            ev_timer_init(&watcher, [](struct ev_loop *, ev_timer *watcher, int) { (*static_cast<std::function<void()> *>(watcher->data))(); }, 0.1, 0);
+            watcher.data = &later;
+            ev_timer_start(loop, &watcher);
+
+            ev_run(loop, 0);
+
+            expect(firedB - startedB >= 0.049).to.beTrue();
+            // instead of once per millisecond
+            expect(wheel.wakeups() < 20).to.beTrue();
+        });
+    });
+});
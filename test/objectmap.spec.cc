@@ -0,0 +1,50 @@
+#include <format>
+#include <memory>
+
+#include "../src/corba/util/objectmap.hh"
+#include "kaffeeklatsch.hh"
+
+using namespace kaffeeklatsch;
+using namespace std;
+using CORBA::blob;
+using CORBA::blob_view;
+using CORBA::detail::ObjectMap;
+
+kaffeeklatsch_spec([] {
+    describe("ObjectMap", [] {
+        it("decodes the counter of OID keys", [] {
+            expect(ObjectMap<shared_ptr<int>>::oid(blob_view("OID:1a"))).to.equal(uint64_t(0x1a));
+            expect(ObjectMap<shared_ptr<int>>::oid(blob_view("OID:01"))).to.equal(uint64_t(0));
+            expect(ObjectMap<shared_ptr<int>>::oid(blob_view("OID:1A"))).to.equal(uint64_t(0));
+            expect(ObjectMap<shared_ptr<int>>::oid(blob_view("NameService"))).to.equal(uint64_t(0));
+        });
+        it("insert, find, erase", [] {
+            ObjectMap<shared_ptr<int>> map;
+            for (int i = 1; i <= 1000; ++i) {
+                map.insert(blob_view(format("OID:{:x}", i)), make_shared<int>(i));
+                map.insert(blob_view(format("key{}", i)), make_shared<int>(-i));
+            }
+            expect(map.size()).to.equal(size_t(2000));
+            expect(map.insert(blob_view("OID:1"), make_shared<int>(0))).to.equal(false);
+
+            for (int i = 1; i <= 1000; ++i) {
+                auto oid = map.find(blob_view(format("OID:{:x}", i)));
+                expect(oid != nullptr).beTrue();
+                expect(*oid).to.equal(i);
+                auto key = map.find(blob_view(format("key{}", i)));
+                expect(key != nullptr).beTrue();
+                expect(*key).to.equal(-i);
+            }
+            expect(map.find(blob_view("OID:fffff")) == nullptr).beTrue();
+            expect(map.find(blob_view("unknown")) == nullptr).beTrue();
+
+            expect(map.erase(blob_view("OID:2"))).beTrue();
+            expect(map.erase(blob_view("key2"))).beTrue();
+            expect(map.erase(blob_view("key2"))).to.equal(false);
+            expect(map.find(blob_view("OID:2")) == nullptr).beTrue();
+            expect(map.find(blob_view("key2")) == nullptr).beTrue();
+            expect(*map.find(blob_view("key3"))).to.equal(-3);
+            expect(map.size()).to.equal(size_t(1998));
+        });
+    });
+});
@@ -0,0 +1,23 @@
+#include "../src/corba/util/operationtable.hh"
+#include "kaffeeklatsch.hh"
+
+using namespace kaffeeklatsch;
+using namespace std;
+using CORBA::detail::OperationTable;
+
+kaffeeklatsch_spec([] {
+    describe("OperationTable", [] {
+        it("maps each operation to it's index", [] {
+            static constexpr OperationTable table({"_get_name", "_set_name", "callBlob", "callBoolean", "callOctet", "ping", "sayA", "sayB"});
+            for (size_t i = 0; i < table.size(); ++i) {
+                expect(table.find(table[i])).to.equal(int(i));
+            }
+        });
+        it("returns -1 for unknown operations", [] {
+            static constexpr OperationTable table({"resolve", "resolve_str"});
+            expect(table.find("resolve_st")).to.equal(-1);
+            expect(table.find("resolve_strx")).to.equal(-1);
+            expect(table.find("")).to.equal(-1);
+        });
+    });
+});
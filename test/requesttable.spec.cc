@@ -0,0 +1,130 @@
+#include <coroutine>
+#include <string>
+
+#include "../src/corba/util/requesttable.hh"
+#include "kaffeeklatsch.hh"
+
+using namespace kaffeeklatsch;
+using namespace std;
+using CORBA::detail::RequestTable;
+
+namespace {
+
+/**
+ * a coroutine which starts right away and is not awaited by anyone
+ */
+struct Task {
+        struct promise_type {
+                Task get_return_object() { return {}; }
+                suspend_never initial_suspend() noexcept { return {}; }
+                suspend_never final_suspend() noexcept { return {}; }
+                void return_void() {}
+                void unhandled_exception() { terminate(); }
+        };
+};
+
+template <size_t N>
+Task await(RequestTable<string, N> &table, uint32_t requestId, string &result) {
+    result = co_await table.suspend(requestId);
+}
+
+Task awaitAndResume(RequestTable<string> &table, vector<string> &order) {
+    order.push_back(co_await table.suspend(0));
+    table.resume(2, "two");
+    order.push_back("after resume(2)");
+}
+
+Task awaitAndRecord(RequestTable<string> &table, vector<string> &order) { order.push_back(co_await table.suspend(2)); }
+
+Task awaitScheduled(RequestTable<string> &table, vector<coroutine_handle<>> &scheduled, vector<string> &order) {
+    order.push_back(co_await table.suspend(
+        0, [&](coroutine_handle<> handle) { scheduled.push_back(handle); }, [&] { order.push_back("suspended"); }));
+}
+
+}  // namespace
+
+kaffeeklatsch_spec([] {
+    describe("RequestTable", [] {
+        it("resumes the coroutine waiting for the request id", [] {
+            RequestTable<string> table;
+            string a, b, c;
+            await(table, 0, a);
+            await(table, 2, b);
+            await(table, 4, c);
+            expect(table.size()).to.equal(3uz);
+
+            expect(table.resume(2, "two")).to.beTrue();
+            expect(table.resume(4, "four")).to.beTrue();
+            expect(table.resume(0, "zero")).to.beTrue();
+
+            expect(a).to.equal("zero");
+            expect(b).to.equal("two");
+            expect(c).to.equal("four");
+            expect(table.empty()).to.beTrue();
+        });
+        it("ignores unknown and late replies", [] {
+            RequestTable<string, 4> table;
+            string a, b;
+            await(table, 2, a);
+            expect(table.resume(4, "unknown")).to.equal(false);
+            expect(table.resume(2, "two")).to.beTrue();
+            expect(table.resume(2, "again")).to.equal(false);
+
+            // request 10 uses the same slot as request 2 did
+            await(table, 10, b);
+            expect(table.resume(2, "late")).to.equal(false);
+            expect(table.resume(10, "ten")).to.beTrue();
+            expect(a).to.equal("two");
+            expect(b).to.equal("ten");
+        });
+        it("handles more outstanding requests than slots", [] {
+            RequestTable<string, 4> table;
+            vector<string> results(10);
+            for (uint32_t i = 0; i < 10; ++i) {
+                await(table, i * 2, results[i]);
+            }
+            expect(table.size()).to.equal(10uz);
+            expect(table.overflows()).to.equal(6uz);
+            for (uint32_t i = 10; i > 0; --i) {
+                expect(table.resume((i - 1) * 2, to_string(i - 1))).to.beTrue();
+            }
+            for (uint32_t i = 0; i < 10; ++i) {
+                expect(results[i]).to.equal(to_string(i));
+            }
+            expect(table.empty()).to.beTrue();
+        });
+        it("resumes a coroutine resumed by another one after that one", [] {
+            RequestTable<string> table;
+            vector<string> order;
+            awaitAndResume(table, order);
+            awaitAndRecord(table, order);
+            expect(table.resume(0, "zero")).to.beTrue();
+            expect(order).to.equal(vector<string>{"zero", "after resume(2)", "two"});
+            expect(table.empty()).to.beTrue();
+        });
+        it("hands the coroutine to the scheduler instead of resuming it", [] {
+            RequestTable<string> table;
+            vector<coroutine_handle<>> scheduled;
+            vector<string> order;
+            awaitScheduled(table, scheduled, order);
+            expect(order).to.equal(vector<string>{"suspended"});
+            expect(table.resume(0, "zero")).to.beTrue();
+            expect(order).to.equal(vector<string>{"suspended"});
+            expect(scheduled.size()).to.equal(1uz);
+            scheduled[0].resume();
+            expect(order).to.equal(vector<string>{"suspended", "zero"});
+        });
+        it("resumes all outstanding requests", [] {
+            RequestTable<string, 4> table;
+            vector<string> results(6);
+            for (uint32_t i = 0; i < 6; ++i) {
+                await(table, i * 2, results[i]);
+            }
+            table.resumeAll("lost");
+            for (auto &result : results) {
+                expect(result).to.equal("lost");
+            }
+            expect(table.empty()).to.beTrue();
+        });
+    });
+});